@@ -2,7 +2,11 @@
 
 
 #include "AssetSpawnerVenice.h"
+#include "EvoStats.h"
 #include "Components/InstancedStaticMeshComponent.h"
+#include "Components/HierarchicalInstancedStaticMeshComponent.h"
+#include "GameFramework/PlayerController.h"
+#include "Async/ParallelFor.h"
 
 // Sets default values
 AAssetSpawnerVenice::AAssetSpawnerVenice()
@@ -48,345 +52,654 @@ void AAssetSpawnerVenice::BeginPlay()
 // Called every frame
 void AAssetSpawnerVenice::Tick(float DeltaTime)
 {
+	LLM_SCOPE_BYTAG(EvoMaps);
 	Super::Tick(DeltaTime);
 
+	ProcessPendingChunks(SpawnBudgetMilliseconds / 1000.0);
 }
 
+// Canal piece per canal neighbor mask, North = 1, East = 2, South = 4, West = 8
+static constexpr uint32 CanalPieceLUT[16] =
+{
+	0,
+	FEvoTileInstruction::TagBit(EEvoInstructionTag::CanalEndNorth),
+	FEvoTileInstruction::TagBit(EEvoInstructionTag::CanalEndEast),
+	FEvoTileInstruction::TagBit(EEvoInstructionTag::CanalEndNorth),
+	FEvoTileInstruction::TagBit(EEvoInstructionTag::CanalEndSouth),
+	FEvoTileInstruction::TagBit(EEvoInstructionTag::CanalNorthSouth),
+	FEvoTileInstruction::TagBit(EEvoInstructionTag::CanalEndSouth),
+	FEvoTileInstruction::TagBit(EEvoInstructionTag::Canal3NoWest),
+	FEvoTileInstruction::TagBit(EEvoInstructionTag::CanalEndWest),
+	FEvoTileInstruction::TagBit(EEvoInstructionTag::CanalEndNorth),
+	FEvoTileInstruction::TagBit(EEvoInstructionTag::CanalEastWest),
+	FEvoTileInstruction::TagBit(EEvoInstructionTag::Canal3NoSouth),
+	FEvoTileInstruction::TagBit(EEvoInstructionTag::CanalEndSouth),
+	FEvoTileInstruction::TagBit(EEvoInstructionTag::Canal3NoEast),
+	FEvoTileInstruction::TagBit(EEvoInstructionTag::Canal3NoNorth),
+	FEvoTileInstruction::TagBit(EEvoInstructionTag::CanalCrossroad),
+};
+
 FEvoAssetMap AAssetSpawnerVenice::TranslateMap(const FEvoGrid& Grid)
 {
+	LLM_SCOPE_BYTAG(EvoMaps);
+	SCOPE_CYCLE_COUNTER(STAT_EvoTranslateMap);
 	int32 Width = Grid.Width;
 	int32 Height = Grid.Height;
 	FEvoAssetMap Map;
 	Map.Initialize(Grid.Width, Grid.Height);
 
+	// Packed word of a row, zero outside the grid
+	auto RowWord = [&Grid, Height](EEvoTileTag Tag, int32 Y, int32 Word) -> uint64
+		{
+			if (Y < 0 || Y >= Height || Word < 0 || Word >= Grid.WordsPerRow)
+			{
+				return 0;
+			}
+			return Grid.GetRow(Tag, Y)[Word];
+		};
 
-
-
-	// Clear any existing tile instructions
-	for (FEvoTileInstruction& TileInstruction : Map.TileInstructions)
-	{
-		TileInstruction.Tags.Empty();
-	}
-
-
-	auto IsValidIndex = [&](int32 X, int32 Y) -> bool
+	// Street or canal in a tile or its left and right neighbors
+	auto OccupiedAround = [&RowWord](int32 Y, int32 Word) -> uint64
 		{
-			return X >= 0 && X < Width && Y >= 0 && Y < Height;
+			const uint64 Center = RowWord(EEvoTileTag::Street, Y, Word) | RowWord(EEvoTileTag::Canal, Y, Word);
+			const uint64 Prev = RowWord(EEvoTileTag::Street, Y, Word - 1) | RowWord(EEvoTileTag::Canal, Y, Word - 1);
+			const uint64 Next = RowWord(EEvoTileTag::Street, Y, Word + 1) | RowWord(EEvoTileTag::Canal, Y, Word + 1);
+			return Center | (Center << 1) | (Prev >> 63) | (Center >> 1) | (Next << 63);
 		};
 
-	auto HasNeighborWithTag = [&](int32 X, int32 Y, EEvoTileTag Tag) -> bool
+	// True if no street or canal can reach word Word of row Y through the 8-neighborhood and no player start is in it
+	auto IsQuietBlock = [&Grid, Height](int32 Y, int32 Word) -> bool
 		{
-			for (int32 OffsetY = -1; OffsetY <= 1; ++OffsetY)
+			if (Grid.GetBlockCount(EEvoTileTag::PlayerStart, Word, Y) != 0)
+			{
+				return false;
+			}
+			for (int32 NeighborY = FMath::Max(Y - 1, 0); NeighborY <= FMath::Min(Y + 1, Height - 1); ++NeighborY)
 			{
-				for (int32 OffsetX = -1; OffsetX <= 1; ++OffsetX)
+				for (int32 NeighborWord = FMath::Max(Word - 1, 0); NeighborWord <= FMath::Min(Word + 1, Grid.WordsPerRow - 1); ++NeighborWord)
 				{
-					if (OffsetX == 0 && OffsetY == 0)
-						continue;
-
-					int32 NeighborX = X + OffsetX;
-					int32 NeighborY = Y + OffsetY;
-
-					if (IsValidIndex(NeighborX, NeighborY))
+					if (Grid.GetBlockCount(EEvoTileTag::Street, NeighborWord, NeighborY) != 0 || Grid.GetBlockCount(EEvoTileTag::Canal, NeighborWord, NeighborY) != 0)
 					{
-						int32 NeighborIndex = NeighborY * Width + NeighborX;
-						if (Grid.Tiles[NeighborIndex].Tags.Contains(Tag))
-						{
-							return true;
-						}
+						return false;
 					}
 				}
 			}
-			return false;
+			return true;
 		};
 
-	for (int32 Y = 0; Y < Height; ++Y)
-	{
-		for (int32 X = 0; X < Width; ++X)
+	// Every row only reads the packed grid and writes its own tiles
+	ParallelFor(Height, [&](int32 Y)
 		{
-			int32 Index = Y * Width + X;
-			const FEvoTile& CurrentTile = Grid.GetTileConst(X,Y);
-			FEvoTileInstruction& CurrentInstruction = Map.TileInstructions[Index];
+			FEvoTileInstruction* RowInstructions = Map.TileInstructions.GetData() + Y * Width;
 
-			if (CurrentTile.Tags.Contains(EEvoTileTag::PlayerStart))
+			for (int32 Word = 0; Word < Grid.WordsPerRow; ++Word)
 			{
-				CurrentInstruction.Tags.Add(EEvoInstructionTag::PlayerStart);
-			}
-
-			// Determine promenade at borders
-			if (CurrentTile.Tags.Contains(EEvoTileTag::Street) && !CurrentTile.Tags.Contains(EEvoTileTag::Canal))
-			{
-				CurrentInstruction.Tags.Add(EEvoInstructionTag::Street);
-			}
-
-			// Handle empty tiles
-			if (!CurrentTile.Tags.Contains(EEvoTileTag::Street) && !CurrentTile.Tags.Contains(EEvoTileTag::Canal))
-			{
-				if (HasNeighborWithTag(X, Y, EEvoTileTag::Street) || HasNeighborWithTag(X, Y, EEvoTileTag::Canal))
+				if (IsQuietBlock(Y, Word))
 				{
-					CurrentInstruction.Tags.Add(EEvoInstructionTag::Building);
+					const int32 FirstX = Word * FEvoGrid::BitsPerWord;
+					const int32 LastX = FMath::Min(FirstX + FEvoGrid::BitsPerWord, Width);
+					for (int32 X = FirstX; X < LastX; ++X)
+					{
+						RowInstructions[X].Tags = FEvoTileInstruction::TagBit(EEvoInstructionTag::BlackBase);
+					}
+					continue;
 				}
-				CurrentInstruction.Tags.Add(EEvoInstructionTag::BlackBase);
-			}
 
-			// Handle canals
-			if (CurrentTile.Tags.Contains(EEvoTileTag::Canal))
-			{
-				bool North = IsValidIndex(X, Y - 1) && Grid.Tiles[(Y - 1) * Width + X].Tags.Contains(EEvoTileTag::Canal);
-				bool South = IsValidIndex(X, Y + 1) && Grid.Tiles[(Y + 1) * Width + X].Tags.Contains(EEvoTileTag::Canal);
-				bool East = IsValidIndex(X + 1, Y) && Grid.Tiles[Y * Width + (X + 1)].Tags.Contains(EEvoTileTag::Canal);
-				bool West = IsValidIndex(X - 1, Y) && Grid.Tiles[Y * Width + (X - 1)].Tags.Contains(EEvoTileTag::Canal);
+				const uint64 Street = RowWord(EEvoTileTag::Street, Y, Word);
+				const uint64 Canal = RowWord(EEvoTileTag::Canal, Y, Word);
+				const uint64 PlayerStart = RowWord(EEvoTileTag::PlayerStart, Y, Word);
 
-				if (North && South && East && West)
-				{
-					CurrentInstruction.Tags.Add(EEvoInstructionTag::CanalCrossroad);
-				}
-				else if (North && South && East)
-				{
-					CurrentInstruction.Tags.Add(EEvoInstructionTag::Canal3NoWest);
-				}
-				else if (North && South && West)
-				{
-					CurrentInstruction.Tags.Add(EEvoInstructionTag::Canal3NoEast);
-				}
-				else if (East && West && North)
-				{
-					CurrentInstruction.Tags.Add(EEvoInstructionTag::Canal3NoSouth);
-				}
-				else if (East && West && South)
-				{
-					CurrentInstruction.Tags.Add(EEvoInstructionTag::Canal3NoNorth);
-				}
-				else if (North && South)
-				{
-					CurrentInstruction.Tags.Add(EEvoInstructionTag::CanalNorthSouth);
-				}
-				else if (East && West)
-				{
-					CurrentInstruction.Tags.Add(EEvoInstructionTag::CanalEastWest);
-				}
-				else if (North)
-				{
-					CurrentInstruction.Tags.Add(EEvoInstructionTag::CanalEndNorth);
-				}
-				else if (South)
-				{
-					CurrentInstruction.Tags.Add(EEvoInstructionTag::CanalEndSouth);
-				}
-				else if (East)
-				{
-					CurrentInstruction.Tags.Add(EEvoInstructionTag::CanalEndEast);
-				}
-				else if (West)
-				{
-					CurrentInstruction.Tags.Add(EEvoInstructionTag::CanalEndWest);
-				}
-			}
+				// Canal neighbors, north is the row above
+				const uint64 CanalNorth = RowWord(EEvoTileTag::Canal, Y - 1, Word);
+				const uint64 CanalSouth = RowWord(EEvoTileTag::Canal, Y + 1, Word);
+				const uint64 CanalEast = (Canal >> 1) | (RowWord(EEvoTileTag::Canal, Y, Word + 1) << 63);
+				const uint64 CanalWest = (Canal << 1) | (RowWord(EEvoTileTag::Canal, Y, Word - 1) >> 63);
 
-			// Handle bridges
-			if (CurrentTile.Tags.Contains(EEvoTileTag::Street) && CurrentTile.Tags.Contains(EEvoTileTag::Canal))
-			{
-				bool VerticalCanal = IsValidIndex(X - 1, Y) && Grid.Tiles[Y * Width + (X - 1)].Tags.Contains(EEvoTileTag::Canal);
-				if (!VerticalCanal)
-				{
-					CurrentInstruction.Tags.Add(EEvoInstructionTag::BridgeNorthSouth);
-				}
-				else
+				// Empty tiles get a building if anything in the 8-neighborhood is street or canal
+				const uint64 Empty = ~(Street | Canal);
+				const uint64 Near = OccupiedAround(Y - 1, Word) | OccupiedAround(Y, Word) | OccupiedAround(Y + 1, Word);
+
+				// Determine promenade at borders
+				const uint64 StreetOnly = Street & ~Canal;
+				const uint64 Building = Empty & Near;
+
+				// Bridges cross a canal that runs north-south unless the canal continues to the west
+				const uint64 Bridge = Street & Canal;
+				const uint64 BridgeEastWest = Bridge & CanalWest;
+				const uint64 BridgeNorthSouth = Bridge & ~CanalWest;
+
+				const int32 FirstX = Word * FEvoGrid::BitsPerWord;
+				const int32 NumBits = FMath::Min(FEvoGrid::BitsPerWord, Width - FirstX);
+				for (int32 Bit = 0; Bit < NumBits; ++Bit)
 				{
-					CurrentInstruction.Tags.Add(EEvoInstructionTag::BridgeEastWest);
+					auto Flag = [Bit](uint64 Bits, EEvoInstructionTag Tag) -> uint32
+						{
+							return static_cast<uint32>((Bits >> Bit) & 1) << static_cast<uint32>(Tag);
+						};
+
+					const uint32 CanalMask = static_cast<uint32>((CanalNorth >> Bit) & 1)
+						| (static_cast<uint32>((CanalEast >> Bit) & 1) << 1)
+						| (static_cast<uint32>((CanalSouth >> Bit) & 1) << 2)
+						| (static_cast<uint32>((CanalWest >> Bit) & 1) << 3);
+					const uint32 IsCanal = static_cast<uint32>((Canal >> Bit) & 1);
+
+					RowInstructions[FirstX + Bit].Tags = Flag(PlayerStart, EEvoInstructionTag::PlayerStart)
+						| Flag(StreetOnly, EEvoInstructionTag::Street)
+						| Flag(Building, EEvoInstructionTag::Building)
+						| Flag(Empty, EEvoInstructionTag::BlackBase)
+						| Flag(BridgeNorthSouth, EEvoInstructionTag::BridgeNorthSouth)
+						| Flag(BridgeEastWest, EEvoInstructionTag::BridgeEastWest)
+						| (CanalPieceLUT[CanalMask] & (0u - IsCanal));
 				}
 			}
-		}
-	}
+		});
 
 	return Map;
 }
 
-void AAssetSpawnerVenice::SpawnMap(FEvoAssetMap AssetMap)
+// Appends the instances of one tile to the per-mesh buffers
+static void AppendTileInstances(const FEvoTileInstruction& TileInstruction, int32 Tile, const FVector& InstanceLocation, FRandomStream& RandomStream, FEvoVeniceInstanceBuffers& Buffers)
 {
+	auto Add = [&Buffers, Tile](EEvoVeniceMesh Mesh, const FTransform& Transform)
+		{
+			Buffers.Add(Mesh, Transform, Tile);
+		};
+
+	// SPAWN REGION
+
+	if (TileInstruction.HasTag(EEvoInstructionTag::PlayerStart))
+	{
+		// Spawn Player Start in the real game
+	}
+
+
+	if (TileInstruction.HasTag(EEvoInstructionTag::Street))
+	{
+		Add(EEvoVeniceMesh::Street, FTransform(InstanceLocation));
+	}
+
+	// Black
+	if (TileInstruction.HasTag(EEvoInstructionTag::BlackBase))
+	{
+		Add(EEvoVeniceMesh::BlackBase, FTransform(InstanceLocation));
+	}
+
+	// Building
+	if (TileInstruction.HasTag(EEvoInstructionTag::Building))
+	{
+		// Pick a random building index: 0, 1, or 2
+		int32 RandomBuildingIndex = RandomStream.RandRange(0, 2);
+
+		// This determines the random rotation for buildings that need it
+		int32 RandomRotationIndex = RandomStream.RandRange(0, 3);
+		float YawRotation = RandomRotationIndex * 90.f;
+		FRotator BuildingRotation(0.f, YawRotation, 0.f);
+
+		// Building 1, 2 or 3
+		const EEvoVeniceMesh BuildingMesh = static_cast<EEvoVeniceMesh>(static_cast<int32>(EEvoVeniceMesh::Building1) + RandomBuildingIndex);
+		Add(BuildingMesh, FTransform(BuildingRotation, InstanceLocation + FVector(0.f, 0.f, 500.f)));
+	}
+
+	// Bridge
+	if (TileInstruction.HasTag(EEvoInstructionTag::BridgeNorthSouth))
+	{
+		FRotator Rotation = FRotator(0.0f, 0.0f, 0.0f);
+		Add(EEvoVeniceMesh::Bridge, FTransform(Rotation, InstanceLocation));
+	}
+	if (TileInstruction.HasTag(EEvoInstructionTag::BridgeEastWest))
+	{
+		FRotator Rotation = FRotator(0.0f, 90.0f, 0.0f);
+		Add(EEvoVeniceMesh::Bridge, FTransform(Rotation, InstanceLocation));
+	}
+
+
+	// Canal 1
+
+	if (TileInstruction.HasTag(EEvoInstructionTag::CanalEndNorth))
+	{
+		Add(EEvoVeniceMesh::Canal1, FTransform(InstanceLocation));
+	}
+	if (TileInstruction.HasTag(EEvoInstructionTag::CanalEndEast))
+	{
+		Add(EEvoVeniceMesh::Canal1, FTransform(InstanceLocation));
+	}
+	if (TileInstruction.HasTag(EEvoInstructionTag::CanalEndSouth))
+	{
+		Add(EEvoVeniceMesh::Canal1, FTransform(InstanceLocation));
+	}
+	if (TileInstruction.HasTag(EEvoInstructionTag::CanalEndWest))
+	{
+		Add(EEvoVeniceMesh::Canal1, FTransform(InstanceLocation));
+	}
+
+	// Canal 2
+
+	if (TileInstruction.HasTag(EEvoInstructionTag::CanalNorthSouth))
+	{
+		FRotator Rotation = FRotator(0.0f, 0.0f, 0.0f);
+		Add(EEvoVeniceMesh::Canal2Straight, FTransform(Rotation, InstanceLocation));
+	}
+	if (TileInstruction.HasTag(EEvoInstructionTag::CanalEastWest))
+	{
+		FRotator Rotation = FRotator(0.0f, 90.0f, 0.0f);
+		Add(EEvoVeniceMesh::Canal2Straight, FTransform(Rotation, InstanceLocation));
+	}
+
+	// Canal 2 Curve
+
+
+	// Canal 3
+	if (TileInstruction.HasTag(EEvoInstructionTag::Canal3NoNorth))
+	{
+		FRotator Rotation = FRotator(0.0f, 90.0f, 0.0f);
+		Add(EEvoVeniceMesh::Canal3, FTransform(Rotation, InstanceLocation));
+	}
+	if (TileInstruction.HasTag(EEvoInstructionTag::Canal3NoEast))
+	{
+		FRotator Rotation = FRotator(0.0f, 180.0f, 0.0f);
+		Add(EEvoVeniceMesh::Canal3, FTransform(Rotation, InstanceLocation));
+	}
+	if (TileInstruction.HasTag(EEvoInstructionTag::Canal3NoSouth))
+	{
+		FRotator Rotation = FRotator(0.0f, 270.0f, 0.0f);
+		Add(EEvoVeniceMesh::Canal3, FTransform(Rotation, InstanceLocation));
+	}
+	if (TileInstruction.HasTag(EEvoInstructionTag::Canal3NoWest))
+	{
+		FRotator Rotation = FRotator(0.0f, 0.0f, 0.0f);
+		Add(EEvoVeniceMesh::Canal3, FTransform(Rotation, InstanceLocation));
+	}
+
+
+
+	// Canal 4
+
+	if (TileInstruction.HasTag(EEvoInstructionTag::CanalCrossroad))
+	{
+		Add(EEvoVeniceMesh::Canal4, FTransform(InstanceLocation));
+	}
+}
+
+void AAssetSpawnerVenice::SpawnMap(const FEvoAssetMap& AssetMap, FRandomStream& RandomStream)
+{
+	LLM_SCOPE_BYTAG(EvoMaps);
+	SCOPE_CYCLE_COUNTER(STAT_EvoSpawnMap);
 	int32 Height = AssetMap.Height;
 	int32 Width = AssetMap.Width;
+	if (Width <= 0 || Height <= 0 || AssetMap.TileInstructions.Num() != Width * Height)
+	{
+		return;
+	}
 
-	int32 NextStartAreaId = 0;
+	// Every tile draws from its own stream, so a tile spawns the same no matter which worker builds it or which other tiles changed
+	const uint32 SpawnSeed = RandomStream.GetUnsignedInt();
 
-	for (int32 Y = 0; Y < Height; ++Y)
+	// A different map or chunk size invalidates every tile index and chunk, start over
+	const int32 NumTiles = Width * Height;
+	const int32 Size = FMath::Max(1, ChunkSize);
+	if (SpawnedAssetMap.Width != Width || SpawnedAssetMap.Height != Height || SpawnedAssetMap.TileInstructions.Num() != NumTiles || BuiltChunkSize != Size)
 	{
-		for (int32 X = 0; X < Width; ++X)
+		ClearMap();
+		SpawnedAssetMap.Initialize(Width, Height);
+		TileInstances.SetNum(NumTiles);
+
+		BuiltChunkSize = Size;
+		for (int32 ChunkY = 0; ChunkY < Height; ChunkY += Size)
 		{
-			const int32 Index = Y * Width + X;
-			if (!AssetMap.TileInstructions.IsValidIndex(Index))
+			for (int32 ChunkX = 0; ChunkX < Width; ChunkX += Size)
 			{
-				continue;
+				FEvoVeniceChunk& Chunk = Chunks.AddDefaulted_GetRef();
+				Chunk.Tiles = FIntRect(ChunkX, ChunkY, FMath::Min(ChunkX + Size, Width), FMath::Min(ChunkY + Size, Height));
 			}
-			const FEvoTileInstruction& TileInstruction = AssetMap.TileInstructions[Index];
+		}
+		ChunkComponents.SetNumZeroed(Chunks.Num() * static_cast<int32>(EEvoVeniceMesh::Num));
+	}
 
-			FVector GridCenterOffset = FVector(Width * 500.0f * 0.5f, Height * 500.0f * 0.5f, 0.0f);
+	PendingAssetMap = AssetMap;
+	PendingSeed = SpawnSeed;
 
-			FVector InstanceLocation = FVector(X * 500.0f, Y * 500.0f, 0.0f) - GridCenterOffset;
+	// Queue the chunks with at least one changed tile
+	TArray<bool> ChunkChanged;
+	ChunkChanged.SetNumZeroed(Chunks.Num());
+	ParallelFor(Chunks.Num(), [this, &ChunkChanged, Width](int32 ChunkIndex)
+		{
+			const FEvoVeniceChunk& Chunk = Chunks[ChunkIndex];
+			const bool bSeedChanged = Chunk.SpawnedSeed != PendingSeed;
+			for (int32 Y = Chunk.Tiles.Min.Y; Y < Chunk.Tiles.Max.Y; ++Y)
+			{
+				for (int32 X = Chunk.Tiles.Min.X; X < Chunk.Tiles.Max.X; ++X)
+				{
+					const FEvoTileInstruction& NewInstruction = PendingAssetMap.TileInstructions[Y * Width + X];
+					const FEvoTileInstruction& OldInstruction = SpawnedAssetMap.TileInstructions[Y * Width + X];
+					if (NewInstruction.Tags != OldInstruction.Tags || (bSeedChanged && NewInstruction.HasTag(EEvoInstructionTag::Building)))
+					{
+						ChunkChanged[ChunkIndex] = true;
+						return;
+					}
+				}
+			}
+		});
 
+	PendingChunks.Reset();
+	for (int32 ChunkIndex = 0; ChunkIndex < Chunks.Num(); ChunkIndex++)
+	{
+		if (ChunkChanged[ChunkIndex])
+		{
+			PendingChunks.Add(ChunkIndex);
+		}
+	}
 
-			// SPAWN REGION
+	// Nearest chunk last, so it is popped first
+	const FVector Focus = GetSpawnFocus(AssetMap);
+	const FVector GridCenterOffset = GetGridCenterOffset();
+	PendingChunks.Sort([this, &Focus, &GridCenterOffset](int32 A, int32 B)
+		{
+			auto DistanceSquared = [this, &Focus, &GridCenterOffset](int32 ChunkIndex)
+				{
+					const FIntRect& Tiles = Chunks[ChunkIndex].Tiles;
+					const FVector Center = FVector((Tiles.Min.X + Tiles.Max.X) * 250.0f, (Tiles.Min.Y + Tiles.Max.Y) * 250.0f, 0.0f) - GridCenterOffset;
+					return FVector::DistSquared2D(Center, Focus);
+				};
+			return DistanceSquared(A) > DistanceSquared(B);
+		});
+
+	if (bSpawnOverFrames)
+	{
+		SetActorTickEnabled(true);
+	}
+	else
+	{
+		FlushPendingChunks();
+	}
+}
 
-			if (TileInstruction.Tags.Contains(EEvoInstructionTag::PlayerStart))
-			{
-				// Spawn Player Start in the real game
-			}
+void AAssetSpawnerVenice::FlushPendingChunks()
+{
+	ProcessPendingChunks(-1.0);
+}
 
+void AAssetSpawnerVenice::ProcessPendingChunks(double BudgetSeconds)
+{
+	SCOPE_CYCLE_COUNTER(STAT_EvoApplyChunks);
+	const double StartTime = FPlatformTime::Seconds();
+	const int32 BatchSize = FMath::Max(1, FTaskGraphInterface::Get().GetNumWorkerThreads());
+	ChunkInstanceBuffers.SetNum(BatchSize);
 
-			if (TileInstruction.Tags.Contains(EEvoInstructionTag::Street))
+	while (PendingChunks.Num() > 0)
+	{
+		// Transforms of a batch are built in parallel, component updates stay on the game thread
+		const int32 NumBatch = FMath::Min(BatchSize, PendingChunks.Num());
+		const int32 First = PendingChunks.Num() - NumBatch;
+		ParallelFor(NumBatch, [this, First](int32 i)
 			{
-				StreetMeshComponent->AddInstance(FTransform(InstanceLocation));
-			}
+				BuildChunkInstances(PendingChunks[First + i], ChunkInstanceBuffers[i]);
+			});
+		for (int32 i = NumBatch - 1; i >= 0; i--)
+		{
+			ApplyChunkInstances(PendingChunks[First + i], ChunkInstanceBuffers[i]);
+		}
+		PendingChunks.SetNum(First, EAllowShrinking::No);
+
+		if (BudgetSeconds >= 0.0 && FPlatformTime::Seconds() - StartTime >= BudgetSeconds)
+		{
+			break;
+		}
+	}
 
-			// Black
-			if (TileInstruction.Tags.Contains(EEvoInstructionTag::BlackBase))
+	if (PendingChunks.Num() == 0)
+	{
+		SetActorTickEnabled(false);
+	}
+}
+
+void AAssetSpawnerVenice::BuildChunkInstances(int32 ChunkIndex, FEvoVeniceInstanceBuffers& Buffers) const
+{
+	LLM_SCOPE_BYTAG(EvoMaps);
+	TRACE_CPUPROFILER_EVENT_SCOPE(AAssetSpawnerVenice::BuildChunkInstances);
+	Buffers.Reset();
+
+	const FEvoVeniceChunk& Chunk = Chunks[ChunkIndex];
+	const bool bSeedChanged = Chunk.SpawnedSeed != PendingSeed;
+	const int32 Width = SpawnedAssetMap.Width;
+	const FVector GridCenterOffset = GetGridCenterOffset();
+
+	for (int32 Y = Chunk.Tiles.Min.Y; Y < Chunk.Tiles.Max.Y; ++Y)
+	{
+		for (int32 X = Chunk.Tiles.Min.X; X < Chunk.Tiles.Max.X; ++X)
+		{
+			const int32 Index = Y * Width + X;
+			const FEvoTileInstruction& TileInstruction = PendingAssetMap.TileInstructions[Index];
+			const FEvoTileInstruction& OldInstruction = SpawnedAssetMap.TileInstructions[Index];
+			const bool bRandomChanged = bSeedChanged && (TileInstruction.HasTag(EEvoInstructionTag::Building) || OldInstruction.HasTag(EEvoInstructionTag::Building));
+			if (TileInstruction.Tags == OldInstruction.Tags && !bRandomChanged)
 			{
-				BlackBaseMeshComponent->AddInstance(FTransform(InstanceLocation));
+				continue;
 			}
 
-			// Building
-			if (TileInstruction.Tags.Contains(EEvoInstructionTag::Building))
-			{
-				// Pick a random building index: 0, 1, or 2
-				int32 RandomBuildingIndex = FMath::RandRange(0, 2);
+			Buffers.DirtyTiles.Add(Index);
+			FRandomStream TileStream(static_cast<int32>(HashCombine(PendingSeed, GetTypeHash(Index))));
+			const FVector InstanceLocation = FVector(X * 500.0f, Y * 500.0f, 0.0f) - GridCenterOffset;
+			AppendTileInstances(TileInstruction, Index, InstanceLocation, TileStream, Buffers);
+		}
+	}
+}
 
-				// This determines the random rotation for buildings that need it
-				int32 RandomRotationIndex = FMath::RandRange(0, 3);
-				float YawRotation = RandomRotationIndex * 90.f;
-				FRotator BuildingRotation(0.f, YawRotation, 0.f);
+void AAssetSpawnerVenice::ApplyChunkInstances(int32 ChunkIndex, FEvoVeniceInstanceBuffers& Buffers)
+{
+	TRACE_CPUPROFILER_EVENT_SCOPE(AAssetSpawnerVenice::ApplyChunkInstances);
 
-				switch (RandomBuildingIndex)
-				{
-				// Building 1
-				case 0:
-				{
-					FTransform BuildingTransform(
-						BuildingRotation,
-						InstanceLocation + FVector(0.f, 0.f, 500.f)
-					);
-					BuildingMeshComponent->AddInstance(BuildingTransform);
-					break;
-				}
+	// Release the instances of the changed tiles, their slots are reused before anything is added or removed
+	TArray<int32> FreedInstances[static_cast<int32>(EEvoVeniceMesh::Num)];
+	for (int32 Tile : Buffers.DirtyTiles)
+	{
+		for (const FEvoVeniceInstanceRef& Ref : TileInstances[Tile])
+		{
+			FreedInstances[static_cast<int32>(Ref.Mesh)].Add(Ref.InstanceIndex);
+		}
+		TileInstances[Tile].Reset();
+		SpawnedAssetMap.TileInstructions[Tile] = PendingAssetMap.TileInstructions[Tile];
+	}
+	Chunks[ChunkIndex].SpawnedSeed = PendingSeed;
 
-				// Building 2
-				case 1:
-				{
-					FTransform BuildingTransform(
-						BuildingRotation,
-						InstanceLocation + FVector(0.f, 0.f, 500.f)
-					);
+	for (int32 MeshIndex = 0; MeshIndex < static_cast<int32>(EEvoVeniceMesh::Num); MeshIndex++)
+	{
+		UpdateMeshInstances(ChunkIndex, static_cast<EEvoVeniceMesh>(MeshIndex), Buffers, FreedInstances[MeshIndex]);
+	}
+}
 
-					BuildingMeshComponent_02->AddInstance(BuildingTransform);
-					break;
-				}
+void AAssetSpawnerVenice::UpdateMeshInstances(int32 ChunkIndex, EEvoVeniceMesh Mesh, const FEvoVeniceInstanceBuffers& Buffers, TArray<int32>& FreedInstances)
+{
+	const int32 MeshIndex = static_cast<int32>(Mesh);
+	const TArray<FTransform>& NewTransforms = Buffers.Transforms[MeshIndex];
+	const TArray<int32>& NewTiles = Buffers.Tiles[MeshIndex];
+	const int32 NumNew = NewTransforms.Num();
+	if (NumNew == 0 && FreedInstances.Num() == 0)
+	{
+		return;
+	}
 
-				// Building 3
-				case 2:
-				{
-					FTransform BuildingTransform(
-						BuildingRotation,
-						InstanceLocation + FVector(0.f, 0.f, 500.f)
-					);
+	INC_DWORD_STAT_BY(STAT_EvoInstancesSpawned, NumNew);
+	TRACE_COUNTER_ADD(EvoMaps_InstancesSpawned, NumNew);
 
-					BuildingMeshComponent_03->AddInstance(BuildingTransform);
-					break;
-				}
-				}
-			}
+	UHierarchicalInstancedStaticMeshComponent* Component = GetChunkComponent(ChunkIndex, Mesh, NumNew > 0);
+	TArray<int32>& Owners = Chunks[ChunkIndex].InstanceTiles[MeshIndex];
 
-			// Bridge
-			if (TileInstruction.Tags.Contains(EEvoInstructionTag::BridgeNorthSouth))
-			{
-				FRotator Rotation = FRotator(0.0f, 0.0f, 0.0f);
-				BridgeMeshComponent->AddInstance(FTransform(Rotation, InstanceLocation));
-			}
-			if (TileInstruction.Tags.Contains(EEvoInstructionTag::BridgeEastWest))
-			{
-				FRotator Rotation = FRotator(0.0f, 90.0f, 0.0f);
-				BridgeMeshComponent->AddInstance(FTransform(Rotation, InstanceLocation));
-			}
+	// Reuse the lowest freed slots, so any surplus sits as close to the end as possible
+	FreedInstances.Sort();
+	const int32 NumReused = FMath::Min(NumNew, FreedInstances.Num());
+	for (int32 i = 0; i < NumReused; i++)
+	{
+		const int32 InstanceIndex = FreedInstances[i];
+		Component->UpdateInstanceTransform(InstanceIndex, NewTransforms[i], false, false, true);
+		Owners[InstanceIndex] = NewTiles[i];
+		TileInstances[NewTiles[i]].Add({ Mesh, InstanceIndex });
+	}
 
+	if (NumNew > NumReused)
+	{
+		// Indices of added instances follow the current ones
+		const int32 FirstAdded = Owners.Num();
+		MeshTransforms.Reset(NumNew - NumReused);
+		MeshTransforms.Append(NewTransforms.GetData() + NumReused, NumNew - NumReused);
+		Component->AddInstances(MeshTransforms, false, false);
+		for (int32 i = NumReused; i < NumNew; i++)
+		{
+			const int32 InstanceIndex = FirstAdded + i - NumReused;
+			Owners.Add(NewTiles[i]);
+			TileInstances[NewTiles[i]].Add({ Mesh, InstanceIndex });
+		}
+		return;
+	}
 
-			// Canal 1
+	if (FreedInstances.Num() > NumReused)
+	{
+		// Fill the freed slots below the new count with live instances from the end, then drop the end.
+		// Removing only trailing instances keeps every other index stable.
+		const int32 NewCount = Owners.Num() - (FreedInstances.Num() - NumReused);
+		TBitArray<> Freed(false, Owners.Num());
+		for (int32 i = NumReused; i < FreedInstances.Num(); i++)
+		{
+			Freed[FreedInstances[i]] = true;
+		}
 
-			if (TileInstruction.Tags.Contains(EEvoInstructionTag::CanalEndNorth))
-			{
-				Canal_1_MeshComponent->AddInstance(FTransform(InstanceLocation));
-			}
-			if (TileInstruction.Tags.Contains(EEvoInstructionTag::CanalEndEast))
-			{
-				Canal_1_MeshComponent->AddInstance(FTransform(InstanceLocation));
-			}
-			if (TileInstruction.Tags.Contains(EEvoInstructionTag::CanalEndSouth))
-			{
-				Canal_1_MeshComponent->AddInstance(FTransform(InstanceLocation));
-			}
-			if (TileInstruction.Tags.Contains(EEvoInstructionTag::CanalEndWest))
+		int32 Tail = Owners.Num() - 1;
+		for (int32 i = NumReused; i < FreedInstances.Num() && FreedInstances[i] < NewCount; i++)
+		{
+			while (Freed[Tail])
 			{
-				Canal_1_MeshComponent->AddInstance(FTransform(InstanceLocation));
+				Tail--;
 			}
+			const int32 Hole = FreedInstances[i];
+			FTransform Transform;
+			Component->GetInstanceTransform(Tail, Transform, false);
+			Component->UpdateInstanceTransform(Hole, Transform, false, false, true);
+			Owners[Hole] = Owners[Tail];
+			RetargetInstanceRef(Owners[Hole], Mesh, Tail, Hole);
+			Tail--;
+		}
 
-			// Canal 2
+		TArray<int32> Trailing;
+		Trailing.Reserve(Owners.Num() - NewCount);
+		for (int32 InstanceIndex = Owners.Num() - 1; InstanceIndex >= NewCount; InstanceIndex--)
+		{
+			Trailing.Add(InstanceIndex);
+		}
+		Component->RemoveInstances(Trailing);
+		Owners.SetNum(NewCount, EAllowShrinking::No);
+	}
 
-			if (TileInstruction.Tags.Contains(EEvoInstructionTag::CanalNorthSouth))
-			{
-				FRotator Rotation = FRotator(0.0f, 0.0f, 0.0f);
-				Canal_2_Straight_MeshComponent->AddInstance(FTransform(Rotation, InstanceLocation));
-			}
-			if (TileInstruction.Tags.Contains(EEvoInstructionTag::CanalEastWest))
-			{
-				FRotator Rotation = FRotator(0.0f, 90.0f, 0.0f);
-				Canal_2_Straight_MeshComponent->AddInstance(FTransform(Rotation, InstanceLocation));
-			}
+	// The in-place updates above skipped the render state, mark it once
+	Component->MarkRenderStateDirty();
+}
 
-			// Canal 2 Curve
+UHierarchicalInstancedStaticMeshComponent* AAssetSpawnerVenice::GetChunkComponent(int32 ChunkIndex, EEvoVeniceMesh Mesh, bool bCreate)
+{
+	UHierarchicalInstancedStaticMeshComponent*& Component = ChunkComponents[ChunkIndex * static_cast<int32>(EEvoVeniceMesh::Num) + static_cast<int32>(Mesh)];
+	if (Component || !bCreate)
+	{
+		return Component;
+	}
 
+	const UInstancedStaticMeshComponent* Template = GetMeshComponent(Mesh);
+	Component = NewObject<UHierarchicalInstancedStaticMeshComponent>(this, NAME_None, RF_Transient);
+	Component->SetStaticMesh(Template->GetStaticMesh());
+	Component->OverrideMaterials = Template->OverrideMaterials;
+	Component->SetCollisionProfileName(Template->GetCollisionProfileName());
+	Component->SetCastShadow(Template->CastShadow);
+	Component->SetCullDistances(InstanceStartCullDistance, InstanceEndCullDistance);
+	Component->SetRelativeTransform(Template->GetRelativeTransform());
+	Component->SetupAttachment(RootComponent);
+	Component->RegisterComponent();
+	return Component;
+}
 
-			// Canal 3
-			if (TileInstruction.Tags.Contains(EEvoInstructionTag::Canal3NoNorth))
-			{
-				FRotator Rotation = FRotator(0.0f, 90.0f, 0.0f);
-				Canal_3_MeshComponent->AddInstance(FTransform(Rotation, InstanceLocation));
-			}
-			if (TileInstruction.Tags.Contains(EEvoInstructionTag::Canal3NoEast))
-			{
-				FRotator Rotation = FRotator(0.0f, 180.0f, 0.0f);
-				Canal_3_MeshComponent->AddInstance(FTransform(Rotation, InstanceLocation));
-			}
-			if (TileInstruction.Tags.Contains(EEvoInstructionTag::Canal3NoSouth))
-			{
-				FRotator Rotation = FRotator(0.0f, 270.0f, 0.0f);
-				Canal_3_MeshComponent->AddInstance(FTransform(Rotation, InstanceLocation));
-			}
-			if (TileInstruction.Tags.Contains(EEvoInstructionTag::Canal3NoWest))
-			{
-				FRotator Rotation = FRotator(0.0f, 0.0f, 0.0f);
-				Canal_3_MeshComponent->AddInstance(FTransform(Rotation, InstanceLocation));
-			}
+FVector AAssetSpawnerVenice::GetSpawnFocus(const FEvoAssetMap& AssetMap) const
+{
+	if (const UWorld* World = GetWorld())
+	{
+		if (const APlayerController* PlayerController = World->GetFirstPlayerController())
+		{
+			FVector ViewLocation;
+			FRotator ViewRotation;
+			PlayerController->GetPlayerViewPoint(ViewLocation, ViewRotation);
+			return GetActorTransform().InverseTransformPosition(ViewLocation);
+		}
+	}
 
+	for (int32 Index = 0; Index < AssetMap.TileInstructions.Num(); Index++)
+	{
+		if (AssetMap.TileInstructions[Index].HasTag(EEvoInstructionTag::PlayerStart))
+		{
+			const int32 X = Index % AssetMap.Width;
+			const int32 Y = Index / AssetMap.Width;
+			return FVector(X * 500.0f, Y * 500.0f, 0.0f) - GetGridCenterOffset();
+		}
+	}
 
+	// Map center
+	return FVector::ZeroVector;
+}
 
-			// Canal 4
+void AAssetSpawnerVenice::RetargetInstanceRef(int32 Tile, EEvoVeniceMesh Mesh, int32 FromIndex, int32 ToIndex)
+{
+	for (FEvoVeniceInstanceRef& Ref : TileInstances[Tile])
+	{
+		if (Ref.Mesh == Mesh && Ref.InstanceIndex == FromIndex)
+		{
+			Ref.InstanceIndex = ToIndex;
+			return;
+		}
+	}
+}
 
-			if (TileInstruction.Tags.Contains(EEvoInstructionTag::CanalCrossroad))
-			{
-				Canal_4_MeshComponent->AddInstance(FTransform(InstanceLocation));
-			}
+UInstancedStaticMeshComponent* AAssetSpawnerVenice::GetMeshComponent(EEvoVeniceMesh Mesh) const
+{
+	switch (Mesh)
+	{
+	case EEvoVeniceMesh::Street: return StreetMeshComponent;
+	case EEvoVeniceMesh::BlackBase: return BlackBaseMeshComponent;
+	case EEvoVeniceMesh::Canal1: return Canal_1_MeshComponent;
+	case EEvoVeniceMesh::Canal2Straight: return Canal_2_Straight_MeshComponent;
+	case EEvoVeniceMesh::Canal2Curve: return Canal_2_Curve_MeshComponent;
+	case EEvoVeniceMesh::Canal3: return Canal_3_MeshComponent;
+	case EEvoVeniceMesh::Canal4: return Canal_4_MeshComponent;
+	case EEvoVeniceMesh::Bridge: return BridgeMeshComponent;
+	case EEvoVeniceMesh::Building1: return BuildingMeshComponent;
+	case EEvoVeniceMesh::Building2: return BuildingMeshComponent_02;
+	case EEvoVeniceMesh::Building3: return BuildingMeshComponent_03;
+	default: return nullptr;
+	}
+}
+
+void AAssetSpawnerVenice::GetMemoryFootprint(FEvoMemoryFootprint& Footprint) const
+{
+	Footprint.AssetMaps += SpawnedAssetMap.GetAllocatedSize() + PendingAssetMap.GetAllocatedSize();
+	Footprint.SpawnerInstances += EvoGetDeepAllocatedSize(TileInstances) + EvoGetDeepAllocatedSize(Chunks) + EvoGetDeepAllocatedSize(ChunkInstanceBuffers)
+		+ PendingChunks.GetAllocatedSize() + MeshTransforms.GetAllocatedSize() + ChunkComponents.GetAllocatedSize();
+	for (UHierarchicalInstancedStaticMeshComponent* Component : ChunkComponents)
+	{
+		if (Component)
+		{
+			Footprint.SpawnerInstances += Component->GetResourceSizeBytes(EResourceSizeMode::Exclusive);
 		}
 	}
 }
 
 void AAssetSpawnerVenice::ClearMap()
 {
-	StreetMeshComponent->ClearInstances();
-	BlackBaseMeshComponent->ClearInstances();
-	Canal_1_MeshComponent->ClearInstances();
-	Canal_2_Straight_MeshComponent->ClearInstances();
-	Canal_2_Curve_MeshComponent->ClearInstances();
-	Canal_3_MeshComponent->ClearInstances();
-	Canal_4_MeshComponent->ClearInstances();
-	BuildingMeshComponent->ClearInstances();
-	BuildingMeshComponent_02->ClearInstances();
-	BuildingMeshComponent_03->ClearInstances();
-	BridgeMeshComponent->ClearInstances();
+	for (UHierarchicalInstancedStaticMeshComponent* Component : ChunkComponents)
+	{
+		if (Component)
+		{
+			Component->DestroyComponent();
+		}
+	}
+	ChunkComponents.Reset();
+	Chunks.Reset();
+	BuiltChunkSize = 0;
+	PendingChunks.Reset();
+
+	SpawnedAssetMap = FEvoAssetMap();
+	PendingAssetMap = FEvoAssetMap();
+	TileInstances.Reset();
 }
-
@@ -5,8 +5,95 @@
 #include "CoreMinimal.h"
 #include "GameFramework/Actor.h"
 #include "EvoStructs.h"
+#include "EvoMemory.h"
 #include "AssetSpawnerVenice.generated.h"
 
+class UInstancedStaticMeshComponent;
+class UHierarchicalInstancedStaticMeshComponent;
+
+// One entry per instanced mesh component of AAssetSpawnerVenice
+enum class EEvoVeniceMesh : uint8
+{
+    Street,
+    BlackBase,
+    Canal1,
+    Canal2Straight,
+    Canal2Curve,
+    Canal3,
+    Canal4,
+    Bridge,
+    Building1,
+    Building2,
+    Building3,
+    Num
+};
+
+// Instance transforms of part of the map, one array per EEvoVeniceMesh, with the tile each instance belongs to
+struct FEvoVeniceInstanceBuffers
+{
+    TArray<FTransform> Transforms[static_cast<int32>(EEvoVeniceMesh::Num)];
+    TArray<int32> Tiles[static_cast<int32>(EEvoVeniceMesh::Num)];
+
+    // Tiles whose instances have to be replaced
+    TArray<int32> DirtyTiles;
+
+    void Add(EEvoVeniceMesh Mesh, const FTransform& Transform, int32 Tile)
+    {
+        Transforms[static_cast<int32>(Mesh)].Add(Transform);
+        Tiles[static_cast<int32>(Mesh)].Add(Tile);
+    }
+
+    void Reset()
+    {
+        for (int32 MeshIndex = 0; MeshIndex < static_cast<int32>(EEvoVeniceMesh::Num); MeshIndex++)
+        {
+            Transforms[MeshIndex].Reset();
+            Tiles[MeshIndex].Reset();
+        }
+        DirtyTiles.Reset();
+    }
+
+    SIZE_T GetAllocatedSize() const
+    {
+        SIZE_T Size = DirtyTiles.GetAllocatedSize();
+        for (int32 MeshIndex = 0; MeshIndex < static_cast<int32>(EEvoVeniceMesh::Num); MeshIndex++)
+        {
+            Size += Transforms[MeshIndex].GetAllocatedSize() + Tiles[MeshIndex].GetAllocatedSize();
+        }
+        return Size;
+    }
+};
+
+// Instance of one of the components, owned by a tile
+struct FEvoVeniceInstanceRef
+{
+    EEvoVeniceMesh Mesh = EEvoVeniceMesh::Street;
+    int32 InstanceIndex = INDEX_NONE;
+};
+
+// Square block of tiles with its own set of components
+struct FEvoVeniceChunk
+{
+    // Min inclusive, Max exclusive, in tiles
+    FIntRect Tiles;
+
+    // Seed the spawned building tiles of this chunk were drawn with
+    uint32 SpawnedSeed = 0;
+
+    // Owning tile of every instance per component
+    TArray<int32> InstanceTiles[static_cast<int32>(EEvoVeniceMesh::Num)];
+
+    SIZE_T GetAllocatedSize() const
+    {
+        SIZE_T Size = 0;
+        for (const TArray<int32>& Owners : InstanceTiles)
+        {
+            Size += Owners.GetAllocatedSize();
+        }
+        return Size;
+    }
+};
+
 UCLASS()
 class EVOLUTIONARYMAPS_API AAssetSpawnerVenice : public AActor
 {
@@ -24,9 +111,26 @@ public:
 	// Called every frame
 	virtual void Tick(float DeltaTime) override;
 
+	// Works on the packed grid words, rows are translated in parallel
 	FEvoAssetMap TranslateMap(const FEvoGrid& Grid);
 
-    void SpawnMap(FEvoAssetMap AssetMap);
+    // Building variants and rotations are drawn from RandomStream, the same stream state spawns the same city.
+    // The map is split into chunks of ChunkSize tiles with their own HISM components. Chunks that differ from the
+    // spawned map are queued nearest to the viewer first and applied over the next frames within SpawnBudgetMilliseconds.
+    // Inside a chunk only changed tiles are touched: instances are re-transformed in place, added in one
+    // AddInstances call or removed from the end of the component.
+    void SpawnMap(const FEvoAssetMap& AssetMap, FRandomStream& RandomStream);
+
+    // Applies all queued chunks now
+    void FlushPendingChunks();
+
+    bool HasPendingChunks() const
+    {
+        return PendingChunks.Num() > 0;
+    }
+
+    // Templates for the chunk components, the mesh, materials, collision and shadows are copied from them
+    UInstancedStaticMeshComponent* GetMeshComponent(EEvoVeniceMesh Mesh) const;
 
 
     // =================================================== Mesh Instance Components =========================================
@@ -65,4 +169,79 @@ public:
     UInstancedStaticMeshComponent* BuildingMeshComponent_03;
 
     void ClearMap();
-};
+
+    // Spawned and pending asset maps, instance bookkeeping and the instance data of the chunk components
+    void GetMemoryFootprint(FEvoMemoryFootprint& Footprint) const;
+
+    // Width and height of a chunk in tiles
+    UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Spawning", meta = (ClampMin = "1"))
+    int32 ChunkSize = 16;
+
+    // Time per frame spent applying queued chunks, at least one batch is applied every frame
+    UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Spawning", meta = (ClampMin = "0"))
+    float SpawnBudgetMilliseconds = 4.f;
+
+    // Off applies every chunk inside SpawnMap
+    UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Spawning")
+    bool bSpawnOverFrames = true;
+
+    // Cull distances of the chunk components, 0 disables distance culling
+    UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Spawning", meta = (ClampMin = "0"))
+    int32 InstanceStartCullDistance = 40000;
+
+    UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Spawning", meta = (ClampMin = "0"))
+    int32 InstanceEndCullDistance = 50000;
+
+private:
+    // Builds the transforms of the changed tiles of a chunk, safe to run for several chunks in parallel
+    void BuildChunkInstances(int32 ChunkIndex, FEvoVeniceInstanceBuffers& Buffers) const;
+
+    // Replaces the instances of the changed tiles of a chunk, game thread only
+    void ApplyChunkInstances(int32 ChunkIndex, FEvoVeniceInstanceBuffers& Buffers);
+
+    // Applies the new instances of the dirty tiles to one component of a chunk
+    void UpdateMeshInstances(int32 ChunkIndex, EEvoVeniceMesh Mesh, const FEvoVeniceInstanceBuffers& Buffers, TArray<int32>& FreedInstances);
+
+    // Applies queued chunks until BudgetSeconds are used up, a negative budget applies all of them
+    void ProcessPendingChunks(double BudgetSeconds);
+
+    // Created on first use, nullptr if nothing was ever spawned with that mesh in the chunk
+    UHierarchicalInstancedStaticMeshComponent* GetChunkComponent(int32 ChunkIndex, EEvoVeniceMesh Mesh, bool bCreate);
+
+    // Viewer location, otherwise the player start, in the space of the instances
+    FVector GetSpawnFocus(const FEvoAssetMap& AssetMap) const;
+
+    // Points the reference of Tile to FromIndex at ToIndex
+    void RetargetInstanceRef(int32 Tile, EEvoVeniceMesh Mesh, int32 FromIndex, int32 ToIndex);
+
+    FVector GetGridCenterOffset() const
+    {
+        return FVector(SpawnedAssetMap.Width * 500.0f * 0.5f, SpawnedAssetMap.Height * 500.0f * 0.5f, 0.0f);
+    }
+
+    // Map the components currently show, empty after ClearMap
+    FEvoAssetMap SpawnedAssetMap;
+
+    // Map and seed of the last SpawnMap call, reached once every chunk is applied
+    FEvoAssetMap PendingAssetMap;
+    uint32 PendingSeed = 0;
+
+    // Chunks left to apply, the nearest one last
+    TArray<int32> PendingChunks;
+
+    TArray<FEvoVeniceChunk> Chunks;
+
+    // ChunkSize the chunks were laid out with, a later change rebuilds them on the next SpawnMap
+    int32 BuiltChunkSize = 0;
+
+    // [Chunk * EEvoVeniceMesh::Num + Mesh]
+    UPROPERTY(Transient)
+    TArray<UHierarchicalInstancedStaticMeshComponent*> ChunkComponents;
+
+    // Instances of every tile, indices are into the components of the tile's chunk
+    TArray<TArray<FEvoVeniceInstanceRef, TInlineAllocator<2>>> TileInstances;
+
+    // Scratch of ProcessPendingChunks, one per chunk of a batch
+    TArray<FEvoVeniceInstanceBuffers> ChunkInstanceBuffers;
+    TArray<FTransform> MeshTransforms;
+};
\ No newline at end of file
@@ -2,21 +2,14 @@
 
 
 #include "EvaluationFunctionLibrary.h"
+#include "EvoDistanceEngine.h"
+#include "EvoStats.h"
+#include "EvoMemory.h"
 
 float UEvaluationFunctionLibrary::TileCount(const FEvoGrid& Grid, EEvoTileTag Tag, int32 TargetCount)
 {
-	int32 Count = 0;
-	for (int32 Y = 0; Y < Grid.Height; Y++)
-	{
-		for (int32 X = 0; X < Grid.Width; X++)
-		{
-			const FEvoTile& Tile = Grid.GetTileConst(X, Y);
-			if (Tile.Tags.Contains(Tag))
-			{
-				Count++;
-			}
-		}
-	}
+	TRACE_CPUPROFILER_EVENT_SCOPE(UEvaluationFunctionLibrary::TileCount);
+	int32 Count = Grid.CountTag(Tag);
 
 	// Calculate the difference from target count
 	float Difference = static_cast<float>(Count) - TargetCount;
@@ -29,314 +22,265 @@ float UEvaluationFunctionLibrary::TileCount(const FEvoGrid& Grid, EEvoTileTag Ta
 
 float UEvaluationFunctionLibrary::StreetCanalOverlap(const FEvoGrid& Grid)
 {
-	float OverlapPenalty = 0.0f;
-
-	// Directions for checking neighbors (Up, Down, Left, Right)
-	const TArray<FIntPoint> Directions = {
-		FIntPoint(0, 1),   // Down
-		FIntPoint(0, -1),  // Up
-		FIntPoint(1, 0),   // Right
-		FIntPoint(-1, 0)   // Left
-	};
-
-	// Iterate over the grid
-	for (int32 Y = 0; Y < Grid.Height; Y++)
+	TRACE_CPUPROFILER_EVENT_SCOPE(UEvaluationFunctionLibrary::StreetCanalOverlap);
+	int32 StreetCount = 0;
+	int32 CanalCount = 0;
+	int32 OverlapTiles = 0;
+	int32 AdjacentPairs = 0;
+	ScanGrid(Grid, StreetCount, CanalCount, OverlapTiles, AdjacentPairs);
+
+	// Penalty is applied once per Street+Canal tile that has a Street+Canal neighbor
+	return -100.0f * OverlapTiles;
+}
+
+void UEvaluationFunctionLibrary::ScanGrid(const FEvoGrid& Grid, int32& OutStreetCount, int32& OutCanalCount, int32& OutOverlapTiles, int32& OutAdjacentPairs)
+{
+	TRACE_CPUPROFILER_EVENT_SCOPE(UEvaluationFunctionLibrary::ScanGrid);
+	OutStreetCount = 0;
+	OutCanalCount = 0;
+	OutOverlapTiles = 0;
+	OutAdjacentPairs = 0;
+
+	const int32 Words = Grid.WordsPerRow;
+	const int32 Height = Grid.Height;
+	if (Grid.BlockCounts.Num() == 0)
 	{
-		for (int32 X = 0; X < Grid.Width; X++)
+		return;
+	}
+
+	OutStreetCount = Grid.CountTag(EEvoTileTag::Street);
+	OutCanalCount = Grid.CountTag(EEvoTileTag::Canal);
+
+	// Overlaps need both tags, blocks without streets or without canals are skipped
+	for (int32 BlockY = 0; BlockY < Height; BlockY += FEvoGrid::BlockRows)
+	{
+		const int32 BlockEndY = FMath::Min(BlockY + FEvoGrid::BlockRows, Height);
+		for (int32 i = 0; i < Words; i++)
 		{
-			const FEvoTile& CurrentTile = Grid.GetTileConst(X, Y);
+			if (Grid.GetBlockCount(EEvoTileTag::Street, i, BlockY) == 0 || Grid.GetBlockCount(EEvoTileTag::Canal, i, BlockY) == 0)
+			{
+				continue;
+			}
 
-			// Check if the current tile has both Street and Canal tags
-			if (CurrentTile.Tags.Contains(EEvoTileTag::Street) && CurrentTile.Tags.Contains(EEvoTileTag::Canal))
+			for (int32 Y = BlockY; Y < BlockEndY; Y++)
 			{
-				// Check all four neighboring tiles
-				for (const FIntPoint& Dir : Directions)
+				const uint64* StreetRow = Grid.GetRow(EEvoTileTag::Street, Y);
+				const uint64* CanalRow = Grid.GetRow(EEvoTileTag::Canal, Y);
+
+				// Street AND Canal
+				const uint64 Current = StreetRow[i] & CanalRow[i];
+				if (Current == 0)
 				{
-					int32 NeighborX = X + Dir.X;
-					int32 NeighborY = Y + Dir.Y;
-
-					// Ensure the neighbor is within grid bounds
-					if (NeighborX >= 0 && NeighborX < Grid.Width && NeighborY >= 0 && NeighborY < Grid.Height)
-					{
-						const FEvoTile& NeighborTile = Grid.GetTileConst(NeighborX, NeighborY);
-
-						// If the neighbor also contains both Street and Canal, apply penalty
-						if (NeighborTile.Tags.Contains(EEvoTileTag::Street) && NeighborTile.Tags.Contains(EEvoTileTag::Canal))
-						{
-							OverlapPenalty -= 100.0f;
-							break;  // No need to check other neighbors; apply penalty once per tile
-						}
-					}
+					continue;
 				}
+
+				const uint64* StreetUp = (Y > 0) ? Grid.GetRow(EEvoTileTag::Street, Y - 1) : nullptr;
+				const uint64* CanalUp = (Y > 0) ? Grid.GetRow(EEvoTileTag::Canal, Y - 1) : nullptr;
+				const uint64* StreetDown = (Y < Height - 1) ? Grid.GetRow(EEvoTileTag::Street, Y + 1) : nullptr;
+				const uint64* CanalDown = (Y < Height - 1) ? Grid.GetRow(EEvoTileTag::Canal, Y + 1) : nullptr;
+
+				// Bit X of Left holds tile X - 1, bit X of Right holds tile X + 1
+				const uint64 Previous = (i > 0) ? (StreetRow[i - 1] & CanalRow[i - 1]) : 0;
+				const uint64 Next = (i < Words - 1) ? (StreetRow[i + 1] & CanalRow[i + 1]) : 0;
+				const uint64 Left = (Current << 1) | (Previous >> 63);
+				const uint64 Right = (Current >> 1) | (Next << 63);
+				const uint64 Up = StreetUp ? (StreetUp[i] & CanalUp[i]) : 0;
+				const uint64 Down = StreetDown ? (StreetDown[i] & CanalDown[i]) : 0;
+
+				OutOverlapTiles += FEvoGrid::PopCount(Current & (Left | Right | Up | Down));
+				OutAdjacentPairs += FEvoGrid::PopCount(Current & Left) + FEvoGrid::PopCount(Current & Right)
+					+ FEvoGrid::PopCount(Current & Up) + FEvoGrid::PopCount(Current & Down);
 			}
 		}
 	}
-
-	return OverlapPenalty;
 }
 
-float UEvaluationFunctionLibrary::PlayerStartDestinationDistance(const TArray<FEvoGraph>& Graphs, const FEvoGrid& Grid, int IdealDistance)
+void UEvaluationFunctionLibrary::GatherKeyPoints(const TArray<FEvoGraph>& Graphs, FEvoKeyPoints& OutKeyPoints)
 {
-	float Value = 0.0f;
-	TArray<FIntPoint> StartPositions;
-	FIntPoint Destination(-1, -1);
+	OutKeyPoints.StartPositions.Reset();
+	OutKeyPoints.Destination = FIntPoint(-1, -1);
 
-	// Search all graphs for PlayerStart and Destination nodes
+	// Search all graphs for PlayerStart and Destination nodes. Ids survive the swaps of node removal, so they give the order.
+	// The last Destination wins, graphs without an index all have INDEX_NONE ids and keep their node order.
+	TArray<TPair<int32, FIntPoint>, TInlineAllocator<16>> Starts;
 	for (const FEvoGraph& Graph : Graphs)
 	{
+		Starts.Reset();
+		int32 DestinationId = MIN_int32;
 		for (const FEvoNode& Node : Graph.Nodes)
 		{
 			if (Node.AdditonalTags.Contains(EEvoTileTag::PlayerStart))
 			{
-				StartPositions.Add(Node.Location);
+				Starts.Emplace(Node.Id, Node.Location);
 			}
-			else if (Node.AdditonalTags.Contains(EEvoTileTag::Destination))
+			else if (Node.AdditonalTags.Contains(EEvoTileTag::Destination) && Node.Id >= DestinationId)
 			{
-				Destination = Node.Location;
+				DestinationId = Node.Id;
+				OutKeyPoints.Destination = Node.Location;
 			}
 		}
+		Starts.StableSort([](const TPair<int32, FIntPoint>& A, const TPair<int32, FIntPoint>& B)
+			{
+				return A.Key < B.Key;
+			});
+		for (const TPair<int32, FIntPoint>& Start : Starts)
+		{
+			OutKeyPoints.StartPositions.Add(Start.Value);
+		}
 	}
+}
 
-	// Ensure at least one PlayerStart and a valid Destination exist
-	if (StartPositions.Num() == 0 || Destination == FIntPoint(-1, -1))
+void UEvaluationFunctionLibrary::ComputeStartDestinationDistances(const FEvoGrid& Grid, const TArray<FIntPoint>& StartPositions, FIntPoint Destination, TArray<int32>& OutDistances)
+{
+	TRACE_CPUPROFILER_EVENT_SCOPE(UEvaluationFunctionLibrary::ComputeStartDestinationDistances);
+
+	// One BFS rooted at the Destination answers every PlayerStart
+	OutDistances.SetNumUninitialized(StartPositions.Num());
+	FEvoDistanceEngine::GetThreadLocal().DistancesTo(Grid, Destination, StartPositions, OutDistances);
+}
+
+void UEvaluationFunctionLibrary::ComputeStartToStartDistances(const FEvoGrid& Grid, const TArray<FIntPoint>& StartPositions, TArray<int32>& OutDistances)
+{
+	TRACE_CPUPROFILER_EVENT_SCOPE(UEvaluationFunctionLibrary::ComputeStartToStartDistances);
+	const int32 NumStarts = StartPositions.Num();
+	OutDistances.SetNumUninitialized(NumStarts * FMath::Max(NumStarts - 1, 0) / 2);
+
+	// Compare each unique pair (avoid redundant checks), one BFS rooted at start j covers every start before it.
+	// Pair (i, j) with i < j is stored at the i-major slot the pairs were always listed in: (0,1), (0,2), ..., (1,2), ...
+	FEvoDistanceEngine& DistanceEngine = FEvoDistanceEngine::GetThreadLocal();
+	TArray<int32, TInlineAllocator<16>> ColumnDistances;
+	for (int32 j = 1; j < NumStarts; j++)
 	{
-		return -100000.0f; // Huge penalty if no start or destination exists
+		ColumnDistances.SetNumUninitialized(j, EAllowShrinking::No);
+		DistanceEngine.DistancesTo(Grid, StartPositions[j], MakeArrayView(StartPositions.GetData(), j), ColumnDistances);
+		for (int32 i = 0; i < j; i++)
+		{
+			OutDistances[i * (2 * NumStarts - i - 1) / 2 + j - i - 1] = ColumnDistances[i];
+		}
 	}
+}
 
-	// Compute the shortest path for each PlayerStart to the Destination
-	for (const FIntPoint& Start : StartPositions)
+float UEvaluationFunctionLibrary::DistancePenalty(const TArray<int32>& Distances, int32 IdealDistance)
+{
+	float Value = 0.0f;
+	for (int32 Distance : Distances)
 	{
-		int32 Distance = FindShortestDistanceStreet(Grid, Start, Destination);
-
 		if (Distance != -1) // If reachable
 		{
-			float Diff = static_cast<float>(Distance) - IdealDistance; 
+			float Diff = static_cast<float>(Distance) - IdealDistance;
 			Value -= Diff * Diff; // Squared penalty
 		}
 		else // If not reachable
 		{
-			Value -= 100000.0f; // Large penalty for unreachable destinations
+			Value -= 100000.0f; // Large penalty for unconnected points
 		}
 	}
-
 	return Value;
 }
 
-
-
-float UEvaluationFunctionLibrary::StartToStartDistance(const TArray<FEvoGraph>& Graphs, const FEvoGrid& Grid, int IdealDistance)
+float UEvaluationFunctionLibrary::PlayerStartDestinationDistance(const TArray<FEvoGraph>& Graphs, const FEvoGrid& Grid, int IdealDistance)
 {
-	float Value = 0.0f;
-	TArray<FIntPoint> StartPositions;
+	LLM_SCOPE_BYTAG(EvoMaps);
+	TRACE_CPUPROFILER_EVENT_SCOPE(UEvaluationFunctionLibrary::PlayerStartDestinationDistance);
+	FEvoKeyPoints KeyPoints;
+	GatherKeyPoints(Graphs, KeyPoints);
 
-	// Collect all PlayerStart positions from all graphs
-	for (const FEvoGraph& Graph : Graphs)
+	// Ensure at least one PlayerStart and a valid Destination exist
+	if (KeyPoints.StartPositions.Num() == 0 || KeyPoints.Destination == FIntPoint(-1, -1))
 	{
-		for (const FEvoNode& Node : Graph.Nodes)
-		{
-			if (Node.AdditonalTags.Contains(EEvoTileTag::PlayerStart))
-			{
-				StartPositions.Add(Node.Location);
-			}
-		}
+		return -100000.0f; // Huge penalty if no start or destination exists
 	}
 
+	TArray<int32> Distances;
+	ComputeStartDestinationDistances(Grid, KeyPoints.StartPositions, KeyPoints.Destination, Distances);
+	return DistancePenalty(Distances, IdealDistance);
+}
+
+float UEvaluationFunctionLibrary::StartToStartDistance(const TArray<FEvoGraph>& Graphs, const FEvoGrid& Grid, int IdealDistance)
+{
+	LLM_SCOPE_BYTAG(EvoMaps);
+	TRACE_CPUPROFILER_EVENT_SCOPE(UEvaluationFunctionLibrary::StartToStartDistance);
+	FEvoKeyPoints KeyPoints;
+	GatherKeyPoints(Graphs, KeyPoints);
+
 	// Ensure at least two start positions exist
-	if (StartPositions.Num() < 2)
+	if (KeyPoints.StartPositions.Num() < 2)
 	{
 		return 0.0f; // No penalty if there are fewer than two spawns
 	}
 
-	// Compare each unique pair (avoid redundant checks)
-	for (int32 i = 0; i < StartPositions.Num() - 1; i++)
-	{
-		for (int32 j = i + 1; j < StartPositions.Num(); j++) // Ensure each pair is checked only once
-		{
-			int32 Distance = FindShortestDistanceStreet(Grid, StartPositions[i], StartPositions[j]);
-
-			if (Distance != -1) // If reachable
-			{
-				float Diff = static_cast<float>(Distance) - IdealDistance;
-				Value -= Diff * Diff;
-			}
-			else // If no path exists between these two spawns
-			{
-				Value -= 100000.0f; // Large penalty for unconnected spawns
-			}
-		}
-	}
-
-	return Value;
+	TArray<int32> Distances;
+	ComputeStartToStartDistances(Grid, KeyPoints.StartPositions, Distances);
+	return DistancePenalty(Distances, IdealDistance);
 }
 
 int32 UEvaluationFunctionLibrary::FindShortestDistanceStreet(const FEvoGrid& Grid, FIntPoint Start, FIntPoint End)
 {
-	// Directions for movement (up, down, left, right)
-	const TArray<FIntPoint> Directions = {
-		FIntPoint(0, 1),  // Down
-		FIntPoint(0, -1), // Up
-		FIntPoint(1, 0),  // Right
-		FIntPoint(-1, 0)  // Left
-	};
-
-	// Queue for BFS
-	TQueue<FIntPoint> Queue;
-
-	// Map to store distances
-	TMap<FIntPoint, int32> Distances;
-
-	// Initialize BFS
-	Queue.Enqueue(Start);
-	Distances.Add(Start, 0);
-
-	while (!Queue.IsEmpty())
-	{
-		FIntPoint Current;
-		Queue.Dequeue(Current);
-
-		// If we reached the end, return the distance
-		if (Current == End)
-		{
-			return Distances[Current];
-		}
-
-		// Explore all 4 possible movements
-		for (const FIntPoint& Direction : Directions)
-		{
-			FIntPoint Neighbor = Current + Direction;
-
-			// Ensure the neighbor is within grid bounds
-			if (Neighbor.X < 0 || Neighbor.X >= Grid.Width || Neighbor.Y < 0 || Neighbor.Y >= Grid.Height)
-			{
-				continue; // Skip out-of-bounds neighbors
-			}
-
-			// Get the tile at this position
-			const FEvoTile& NeighborTile = Grid.GetTileConst(Neighbor.X, Neighbor.Y);
-
-			// Check if it's a street and hasn't been visited
-			if (NeighborTile.Tags.Contains(EEvoTileTag::Street) && !Distances.Contains(Neighbor))
-			{
-				// Add to queue
-				Queue.Enqueue(Neighbor);
+	return FEvoDistanceEngine::GetThreadLocal().Distance(Grid, Start, End);
+}
 
-				// Store distance
-				Distances.Add(Neighbor, Distances[Current] + 1);
-			}
-		}
-	}
+FEvoFitness UEvaluationFunctionLibrary::EvaluateMap(const TArray<FEvoGraph>& Graphs, const FEvoGrid& Grid, const FEvoEvaluationParams& Params)
+{
+	FEvoFitness Fitness;
+	EvaluateMapInto(Graphs, Grid, Params, Fitness);
+	return Fitness;
+}
 
-	return -1; // No valid path found
+void UEvaluationFunctionLibrary::EvaluateMapInto(const TArray<FEvoGraph>& Graphs, const FEvoGrid& Grid, const FEvoEvaluationParams& Params, FEvoFitness& OutFitness)
+{
+	LLM_SCOPE_BYTAG(EvoMaps);
+	FEvoKeyPoints KeyPoints;
+	GatherKeyPoints(Graphs, KeyPoints);
+	EvaluateMapInto(KeyPoints, Grid, Params, OutFitness);
 }
 
-void UEvaluationFunctionLibrary::AnalyzeMap(const TArray<FEvoGraph>& Graphs, const FEvoGrid& Grid)
+void UEvaluationFunctionLibrary::EvaluateMapInto(const FEvoKeyPoints& KeyPoints, const FEvoGrid& Grid, const FEvoEvaluationParams& Params, FEvoFitness& OutFitness)
 {
-	int32 StreetCount = 0;
-	int32 CanalCount = 0;
-	int32 AdjacentWaterCanalPairs = 0;
-	TArray<int32> StartToDestinationDistances;
-	TArray<int32> StartToStartDistances;
-	TArray<FIntPoint> StartPositions;
-	FIntPoint Destination(-1, -1);
-
-	// Iterate over grid to count Street & Canal tiles
-	for (int32 Y = 0; Y < Grid.Height; Y++)
+	LLM_SCOPE_BYTAG(EvoMaps);
+	SCOPE_CYCLE_COUNTER(STAT_EvoEvaluate);
+
+	// Grid terms
+	ScanGrid(Grid, OutFitness.StreetCount, OutFitness.CanalCount, OutFitness.OverlapTiles, OutFitness.AdjacentOverlapPairs);
+	OutFitness.StreetCountPenalty = -FMath::Abs(static_cast<float>(OutFitness.StreetCount) - Params.TargetStreetTiles);
+	OutFitness.CanalCountPenalty = -FMath::Abs(static_cast<float>(OutFitness.CanalCount) - Params.TargetCanalTiles);
+	OutFitness.OverlapPenalty = -100.0f * OutFitness.OverlapTiles;
+
+	// Graph terms, the key points are shared by both distance terms
+	const TArray<FIntPoint>& StartPositions = KeyPoints.StartPositions;
+	const FIntPoint Destination = KeyPoints.Destination;
+	if (Destination != FIntPoint(-1, -1))
 	{
-		for (int32 X = 0; X < Grid.Width; X++)
-		{
-			const FEvoTile& Tile = Grid.GetTileConst(X, Y);
-
-			if (Tile.Tags.Contains(EEvoTileTag::Street))
-			{
-				StreetCount++;
-			}
-			if (Tile.Tags.Contains(EEvoTileTag::Canal))
-			{
-				CanalCount++;
-			}
-
-			// Check for adjacent Water-Canal pairs
-			const TArray<FIntPoint> Directions = {
-				FIntPoint(0, 1),   // Down
-				FIntPoint(0, -1),  // Up
-				FIntPoint(1, 0),   // Right
-				FIntPoint(-1, 0)   // Left
-			};
-
-			if (Tile.Tags.Contains(EEvoTileTag::Street) && Tile.Tags.Contains(EEvoTileTag::Canal))
-			{
-				// Check all four neighboring tiles
-				for (const FIntPoint& Dir : Directions)
-				{
-					int32 NeighborX = X + Dir.X;
-					int32 NeighborY = Y + Dir.Y;
-
-					// Ensure within grid bounds
-					if (NeighborX >= 0 && NeighborX < Grid.Width && NeighborY >= 0 && NeighborY < Grid.Height)
-					{
-						const FEvoTile& NeighborTile = Grid.GetTileConst(NeighborX, NeighborY);
-
-						// Check if the neighbor ALSO has both Street and Canal tags
-						if (NeighborTile.Tags.Contains(EEvoTileTag::Street) && NeighborTile.Tags.Contains(EEvoTileTag::Canal))
-						{
-							AdjacentWaterCanalPairs++;
-						}
-					}
-				}
-			}
-		}
+		ComputeStartDestinationDistances(Grid, StartPositions, Destination, OutFitness.StartToDestinationDistances);
 	}
-
-	// Find PlayerStart and Destination positions
-	for (const FEvoGraph& Graph : Graphs)
+	else
 	{
-		for (const FEvoNode& Node : Graph.Nodes)
-		{
-			if (Node.AdditonalTags.Contains(EEvoTileTag::PlayerStart))
-			{
-				StartPositions.Add(Node.Location);
-			}
-			else if (Node.AdditonalTags.Contains(EEvoTileTag::Destination))
-			{
-				Destination = Node.Location;
-			}
-		}
+		OutFitness.StartToDestinationDistances.Reset();
 	}
+	ComputeStartToStartDistances(Grid, StartPositions, OutFitness.StartToStartDistances);
 
-	// Calculate distances from each Start to the Destination
-	if (Destination != FIntPoint(-1, -1))
-	{
-		for (const FIntPoint& Start : StartPositions)
-		{
-			int32 Distance = FindShortestDistanceStreet(Grid, Start, Destination);
-			if (Distance != -1)
-			{
-				StartToDestinationDistances.Add(Distance);
-			}
-		}
-	}
+	OutFitness.StartDestinationPenalty = (StartPositions.Num() == 0 || Destination == FIntPoint(-1, -1))
+		? -100000.0f
+		: DistancePenalty(OutFitness.StartToDestinationDistances, Params.TargetStartDestinationDistance);
+	OutFitness.StartStartPenalty = DistancePenalty(OutFitness.StartToStartDistances, Params.TargetStartStartDistance);
 
-	// Calculate distances between every Start pair
-	if (StartPositions.Num() >= 2)
-	{
-		for (int32 i = 0; i < StartPositions.Num() - 1; i++)
-		{
-			for (int32 j = i + 1; j < StartPositions.Num(); j++)
-			{
-				int32 Distance = FindShortestDistanceStreet(Grid, StartPositions[i], StartPositions[j]);
-				if (Distance != -1)
-				{
-					StartToStartDistances.Add(Distance);
-				}
-			}
-		}
-	}
+	OutFitness.Score = OutFitness.StreetCountPenalty + OutFitness.CanalCountPenalty + OutFitness.OverlapPenalty
+		+ OutFitness.StartDestinationPenalty + OutFitness.StartStartPenalty;
+}
+
+void UEvaluationFunctionLibrary::AnalyzeMap(const TArray<FEvoGraph>& Graphs, const FEvoGrid& Grid)
+{
+	LLM_SCOPE_BYTAG(EvoMaps);
+	// Distances and counts do not depend on the targets, so the defaults are fine here
+	const FEvoFitness Fitness = EvaluateMap(Graphs, Grid, FEvoEvaluationParams());
+
+	TArray<int32> StartToDestinationDistances = Fitness.StartToDestinationDistances.FilterByPredicate([](int32 Distance) { return Distance != -1; });
+	TArray<int32> StartToStartDistances = Fitness.StartToStartDistances.FilterByPredicate([](int32 Distance) { return Distance != -1; });
 
 	// Log the results
 	UE_LOG(LogTemp, Warning, TEXT("Analysis Results:"));
-	UE_LOG(LogTemp, Warning, TEXT("Total Street Tiles: %d"), StreetCount);
-	UE_LOG(LogTemp, Warning, TEXT("Total Canal Tiles: %d"), CanalCount);
-	UE_LOG(LogTemp, Warning, TEXT("Adjacent Water-Canal Pairs: %d"), AdjacentWaterCanalPairs);
+	UE_LOG(LogTemp, Warning, TEXT("Total Street Tiles: %d"), Fitness.StreetCount);
+	UE_LOG(LogTemp, Warning, TEXT("Total Canal Tiles: %d"), Fitness.CanalCount);
+	UE_LOG(LogTemp, Warning, TEXT("Adjacent Water-Canal Pairs: %d"), Fitness.AdjacentOverlapPairs);
 
 	FString StartToDestinationStr = "Distances Start → Destination: ";
 	for (int32 Distance : StartToDestinationDistances)
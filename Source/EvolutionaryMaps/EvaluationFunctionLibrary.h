@@ -28,10 +28,33 @@ public:
 	UFUNCTION(BlueprintCallable, Category = "Evaluation")
 	static float StartToStartDistance(const TArray<FEvoGraph>& Graphs, const FEvoGrid& Grid, int IdealDistance);
 
+	// All fitness terms from one grid scan and one key node pass
+	UFUNCTION(BlueprintCallable, Category = "Evaluation")
+	static FEvoFitness EvaluateMap(const TArray<FEvoGraph>& Graphs, const FEvoGrid& Grid, const FEvoEvaluationParams& Params);
+
+	// Same as EvaluateMap, but reuses the distance arrays already held by OutFitness
+	static void EvaluateMapInto(const TArray<FEvoGraph>& Graphs, const FEvoGrid& Grid, const FEvoEvaluationParams& Params, FEvoFitness& OutFitness);
+
+	// Same again with key points gathered earlier, e.g. the incumbent's while a mutation left its PlayerStart and Destination nodes alone
+	static void EvaluateMapInto(const FEvoKeyPoints& KeyPoints, const FEvoGrid& Grid, const FEvoEvaluationParams& Params, FEvoFitness& OutFitness);
+
+	// Reuses the arrays already held by OutKeyPoints
+	static void GatherKeyPoints(const TArray<FEvoGraph>& Graphs, FEvoKeyPoints& OutKeyPoints);
+
 	UFUNCTION(BlueprintCallable, Category = "Analysis")
 	static void AnalyzeMap(const TArray<FEvoGraph>& Graphs, const FEvoGrid& Grid);
 
 
 private:
 	static int32 FindShortestDistanceStreet(const FEvoGrid& Grid, FIntPoint Start, FIntPoint End);
+
+	// Single pass over the packed rows. OutOverlapTiles counts Street+Canal tiles with at least one Street+Canal neighbor,
+	// OutAdjacentPairs counts every such neighbor (each pair is seen from both sides).
+	static void ScanGrid(const FEvoGrid& Grid, int32& OutStreetCount, int32& OutCanalCount, int32& OutOverlapTiles, int32& OutAdjacentPairs);
+
+	// Fill OutDistances with one entry per start (start to destination) or per start pair (start to start), -1 if unreachable
+	static void ComputeStartDestinationDistances(const FEvoGrid& Grid, const TArray<FIntPoint>& StartPositions, FIntPoint Destination, TArray<int32>& OutDistances);
+	static void ComputeStartToStartDistances(const FEvoGrid& Grid, const TArray<FIntPoint>& StartPositions, TArray<int32>& OutDistances);
+
+	static float DistancePenalty(const TArray<int32>& Distances, int32 IdealDistance);
 };
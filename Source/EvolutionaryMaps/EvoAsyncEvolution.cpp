@@ -0,0 +1,178 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "EvoAsyncEvolution.h"
+#include "EvoTelemetry.h"
+#include "EvoStats.h"
+#include "Async/Async.h"
+
+FEvoAsyncEvolution::FEvoAsyncEvolution(UEvoMapGenerator* InMapGen, const FEvoAsyncEvolutionParams& InParams)
+	: MapGen(InMapGen)
+	, Params(InParams)
+	, CancellationToken(InParams.CancellationToken.IsValid() ? InParams.CancellationToken.ToSharedRef() : MakeShared<FEvoCancellationToken, ESPMode::ThreadSafe>())
+{
+}
+
+TSharedRef<FEvoAsyncEvolution, ESPMode::ThreadSafe> FEvoAsyncEvolution::Launch(UEvoMapGenerator* MapGen, const FEvoAsyncEvolutionParams& Params, FOnProgress OnProgress, FOnCompleted OnCompleted)
+{
+	check(IsInGameThread());
+	check(MapGen);
+
+	TSharedRef<FEvoAsyncEvolution, ESPMode::ThreadSafe> AsyncEvolution = MakeShareable(new FEvoAsyncEvolution(MapGen, Params));
+	AsyncEvolution->OnProgress = MoveTemp(OnProgress);
+	AsyncEvolution->OnCompleted = MoveTemp(OnCompleted);
+	AsyncEvolution->Task = UE::Tasks::Launch(UE_SOURCE_LOCATION, [AsyncEvolution]()
+		{
+			AsyncEvolution->Run();
+		}, UE::Tasks::ETaskPriority::BackgroundNormal);
+	return AsyncEvolution;
+}
+
+const FEvoEvolutionSnapshot* FEvoAsyncEvolution::PollSnapshot()
+{
+	check(IsInGameThread());
+	if (!Snapshots.IsDirty())
+	{
+		return nullptr;
+	}
+	Snapshots.SwapReadBuffers();
+	return &Snapshots.Read();
+}
+
+void FEvoAsyncEvolution::Run()
+{
+	LLM_SCOPE_BYTAG(EvoMaps);
+	TRACE_CPUPROFILER_EVENT_SCOPE(FEvoAsyncEvolution::Run);
+	if (Params.Islands.NumIslands > 1)
+	{
+		RunIslands();
+		return;
+	}
+
+	FEvoEvolution Evolution;
+	Evolution.Initialize(MapGen, Params.Settings);
+	Evolution.ResetToVeniceStart();
+	Publish(Evolution, Params.Settings.Seed);
+
+	// Every callback is a game thread task, so they are capped even with a zero interval
+	const double PublishInterval = FMath::Max(Params.PublishIntervalSeconds, 0.01f);
+	double LastPublishTime = FPlatformTime::Seconds();
+	bool bChangedSincePublish = false;
+	while (Evolution.IterationCounter < Params.MaximumIterations && !CancellationToken->IsCancelled())
+	{
+		const bool bAccepted = Evolution.StepIteration();
+		if (Params.Telemetry)
+		{
+			Params.Telemetry->RecordIteration(Evolution, bAccepted);
+		}
+		bChangedSincePublish |= bAccepted;
+
+		const double Now = FPlatformTime::Seconds();
+		if (Now - LastPublishTime < PublishInterval)
+		{
+			continue;
+		}
+		LastPublishTime = Now;
+
+		if (bChangedSincePublish)
+		{
+			Publish(Evolution, Params.Settings.Seed);
+			bChangedSincePublish = false;
+		}
+
+		// Progress is reported even without a new snapshot so loading screens keep moving
+		PostProgress(Evolution.IterationCounter, Evolution.IncumbentFitness);
+	}
+
+	if (bChangedSincePublish)
+	{
+		Publish(Evolution, Params.Settings.Seed);
+	}
+
+	PostCompleted(Evolution);
+}
+
+void FEvoAsyncEvolution::RunIslands()
+{
+	FEvoIslandEvolution IslandEvolution;
+	IslandEvolution.Initialize(MapGen, Params.Settings, Params.Islands);
+
+	// Only a new global best is published, islands report it one at a time
+	const double PublishInterval = FMath::Max(Params.PublishIntervalSeconds, 0.01f);
+	double LastPublishTime = -MAX_dbl;
+	IslandEvolution.Run(Params.MaximumIterations,
+		[this]()
+		{
+			return CancellationToken->IsCancelled();
+		},
+		[this, PublishInterval, &LastPublishTime](const FEvoEvolution& Island)
+		{
+			const double Now = FPlatformTime::Seconds();
+			if (Now - LastPublishTime < PublishInterval)
+			{
+				return;
+			}
+			LastPublishTime = Now;
+			Publish(Island, Params.Settings.Seed);
+			PostProgress(Island.IterationCounter, Island.IncumbentFitness);
+		});
+
+	// The last improvement may have been skipped by the interval
+	FEvoEvolution& Best = IslandEvolution.GetIsland(IslandEvolution.GetBestIslandIndex());
+	Publish(Best, Params.Settings.Seed);
+	PostCompleted(Best);
+}
+
+FEvoMemoryFootprint FEvoAsyncEvolution::GetMemoryFootprint() const
+{
+	FScopeLock Lock(&FootprintLock);
+	return PublishedFootprint;
+}
+
+void FEvoAsyncEvolution::PostProgress(int32 Iteration, const FEvoFitness& Fitness)
+{
+	AsyncTask(ENamedThreads::GameThread, [Self = AsShared(), Iteration, Fitness]()
+		{
+			Self->OnProgress.ExecuteIfBound(Iteration, Fitness);
+		});
+}
+
+void FEvoAsyncEvolution::PostCompleted(FEvoEvolution& Evolution)
+{
+	Result.Graphs = MoveTemp(Evolution.EvoGraphs);
+	Result.Grid = MoveTemp(Evolution.IncumbentGrid);
+	Result.Fitness = Evolution.IncumbentFitness;
+	Result.Iteration = Evolution.IterationCounter;
+	Result.Seed = Params.Settings.Seed;
+
+	AsyncTask(ENamedThreads::GameThread, [Self = AsShared(), bCancelled = CancellationToken->IsCancelled()]()
+		{
+			Self->OnCompleted.ExecuteIfBound(&Self.Get(), Self->Result, bCancelled);
+		});
+}
+
+void FEvoAsyncEvolution::Publish(const FEvoEvolution& Evolution, int32 Seed)
+{
+	TRACE_CPUPROFILER_EVENT_SCOPE(FEvoAsyncEvolution::Publish);
+
+	// The write buffer is the snapshot from two publishes ago, assigning reuses its allocations
+	FEvoEvolutionSnapshot& Snapshot = Snapshots.GetWriteBuffer();
+	Snapshot.Graphs = Evolution.EvoGraphs;
+	Snapshot.Grid = Evolution.IncumbentGrid;
+	Snapshot.Fitness = Evolution.IncumbentFitness;
+	Snapshot.Iteration = Evolution.IterationCounter;
+	Snapshot.Seed = Seed;
+
+	// All three snapshot buffers converge on the size of the newest one
+	FEvoMemoryFootprint Footprint;
+	Evolution.GetMemoryFootprint(Footprint);
+	for (int32 Buffer = 0; Buffer < 3; Buffer++)
+	{
+		Snapshot.GetMemoryFootprint(Footprint);
+	}
+	Snapshots.SwapWriteBuffers();
+	{
+		FScopeLock Lock(&FootprintLock);
+		PublishedFootprint = Footprint;
+	}
+}
@@ -0,0 +1,131 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Containers/TripleBuffer.h"
+#include "Tasks/Task.h"
+#include "EvoStructs.h"
+#include "EvoEvolution.h"
+#include "EvoIslandEvolution.h"
+#include <atomic>
+
+class UEvoMapGenerator;
+class FEvoTelemetry;
+
+// Shared between the caller and a background run, the run stops after the iteration in progress once cancelled
+class FEvoCancellationToken
+{
+public:
+	void Cancel()
+	{
+		bCancelled.store(true, std::memory_order_relaxed);
+	}
+
+	bool IsCancelled() const
+	{
+		return bCancelled.load(std::memory_order_relaxed);
+	}
+
+private:
+	std::atomic<bool> bCancelled { false };
+};
+
+// Copy of the incumbent that the game thread can read while the run continues
+struct FEvoEvolutionSnapshot
+{
+	TArray<FEvoGraph> Graphs;
+	FEvoGrid Grid;
+	FEvoFitness Fitness;
+	int32 Iteration = 0;
+	int32 Seed = 0;
+
+	void GetMemoryFootprint(FEvoMemoryFootprint& Footprint) const
+	{
+		Footprint.Graphs += EvoGetDeepAllocatedSize(Graphs);
+		Footprint.Grids += Grid.GetAllocatedSize();
+		Footprint.Other += Fitness.GetAllocatedSize();
+	}
+};
+
+struct FEvoAsyncEvolutionParams
+{
+	FEvoEvolutionSettings Settings;
+	int32 MaximumIterations = 1000;
+
+	// Minimum time between snapshots and progress callbacks, a snapshot is only taken after an acceptance
+	float PublishIntervalSeconds = 0.1f;
+
+	// More than one island runs FEvoIslandEvolution, MaximumIterations then applies to every island
+	FEvoIslandSettings Islands;
+
+	// Optional, not owned. Records are pushed from the worker, which is the single producer of its queue. Not recorded with islands.
+	FEvoTelemetry* Telemetry = nullptr;
+
+	// Optional, a new token is created if none is given
+	TSharedPtr<FEvoCancellationToken, ESPMode::ThreadSafe> CancellationToken;
+};
+
+/**
+ * Runs FEvoEvolution as a background task so the game thread never blocks on a whole run.
+ * Delegates are called on the game thread. MapGen is not owned and has to outlive the run, cancel and Wait before releasing it.
+ */
+class EVOLUTIONARYMAPS_API FEvoAsyncEvolution : public TSharedFromThis<FEvoAsyncEvolution, ESPMode::ThreadSafe>
+{
+public:
+	DECLARE_DELEGATE_TwoParams(FOnProgress, int32 /*Iteration*/, const FEvoFitness& /*Fitness*/);
+	// Sender tells a completion of the current run apart from one of an earlier run that was still queued when it was replaced
+	DECLARE_DELEGATE_ThreeParams(FOnCompleted, const FEvoAsyncEvolution* /*Sender*/, const FEvoEvolutionSnapshot& /*Result*/, bool /*bCancelled*/);
+
+	static TSharedRef<FEvoAsyncEvolution, ESPMode::ThreadSafe> Launch(UEvoMapGenerator* MapGen, const FEvoAsyncEvolutionParams& Params, FOnProgress OnProgress, FOnCompleted OnCompleted);
+
+	void Cancel()
+	{
+		CancellationToken->Cancel();
+	}
+
+	// Blocks until the worker has returned, the completion delegate may still be queued on the game thread
+	void Wait()
+	{
+		Task.Wait();
+	}
+
+	bool IsRunning() const
+	{
+		return !Task.IsCompleted();
+	}
+
+	// Game thread only. Returns the newest snapshot if one was published since the last call, otherwise nullptr.
+	// The pointer stays valid until the next call.
+	const FEvoEvolutionSnapshot* PollSnapshot();
+
+	// Worker evolution and snapshot buffers as of the last publish. With islands only the publishing island is counted.
+	FEvoMemoryFootprint GetMemoryFootprint() const;
+
+private:
+	FEvoAsyncEvolution(UEvoMapGenerator* InMapGen, const FEvoAsyncEvolutionParams& InParams);
+
+	void Run();
+	void RunIslands();
+	void Publish(const FEvoEvolution& Evolution, int32 Seed);
+	void PostProgress(int32 Iteration, const FEvoFitness& Fitness);
+	void PostCompleted(FEvoEvolution& Evolution);
+
+	UEvoMapGenerator* MapGen = nullptr;
+	FEvoAsyncEvolutionParams Params;
+	TSharedRef<FEvoCancellationToken, ESPMode::ThreadSafe> CancellationToken;
+
+	FOnProgress OnProgress;
+	FOnCompleted OnCompleted;
+
+	UE::Tasks::FTask Task;
+
+	// Written by the worker, read by the game thread, neither side waits for the other
+	TTripleBuffer<FEvoEvolutionSnapshot> Snapshots;
+
+	// Handed to OnCompleted, only touched by the worker until completion is posted
+	FEvoEvolutionSnapshot Result;
+
+	mutable FCriticalSection FootprintLock;
+	FEvoMemoryFootprint PublishedFootprint;
+};
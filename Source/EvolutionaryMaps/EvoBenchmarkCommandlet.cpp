@@ -0,0 +1,313 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "EvoBenchmarkCommandlet.h"
+#include "EvoMapGenerator.h"
+#include "EvaluationFunctionLibrary.h"
+#include "AssetSpawnerVenice.h"
+#include "Engine/World.h"
+#include "Async/TaskGraphInterfaces.h"
+#include "JsonObjectConverter.h"
+#include "Misc/App.h"
+#include "Misc/EngineVersion.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+#include "UObject/StrongObjectPtr.h"
+#include "ProfilingDebugging/CpuProfilerTrace.h"
+
+DEFINE_LOG_CATEGORY_STATIC(LogEvoBenchmark, Log, All);
+
+// Raw samples of one stage and configuration, summarized into an FEvoBenchmarkStageResult
+struct FEvoStageSamples
+{
+	TArray<double> Seconds;
+	int32 ItemsPerCall = 0;
+};
+
+static TArray<int32> ParseIntList(const TCHAR* Cmd, const TCHAR* Name, const TArray<int32>& Default)
+{
+	FString List;
+	if (!FParse::Value(Cmd, Name, List, false))
+	{
+		return Default;
+	}
+	TArray<FString> Entries;
+	List.ParseIntoArray(Entries, TEXT(","));
+	TArray<int32> Values;
+	for (const FString& Entry : Entries)
+	{
+		Values.Add(FCString::Atoi(*Entry));
+	}
+	return Values;
+}
+
+// Nearest rank percentile of sorted samples
+static double Percentile(const TArray<double>& Sorted, double Fraction)
+{
+	check(Sorted.Num() > 0);
+	const int32 Rank = FMath::CeilToInt(Fraction * Sorted.Num()) - 1;
+	return Sorted[FMath::Clamp(Rank, 0, Sorted.Num() - 1)];
+}
+
+UEvoBenchmarkCommandlet::UEvoBenchmarkCommandlet()
+{
+	IsClient = false;
+	IsServer = false;
+	IsEditor = false;
+	LogToConsole = true;
+}
+
+int32 UEvoBenchmarkCommandlet::Main(const FString& Params)
+{
+	LLM_SCOPE_BYTAG(EvoMaps);
+	const TCHAR* Cmd = *Params;
+
+	const TArray<int32> Sizes = ParseIntList(Cmd, TEXT("Sizes="), { 64, 128, 256, 512, 1024 });
+	const TArray<int32> NodeCounts = ParseIntList(Cmd, TEXT("Nodes="), { 0, 100, 1000 });
+	int32 NumSeeds = 3;
+	int32 NumSamples = 30;
+	int32 NumWarmup = 3;
+	int32 Mutations = 20;
+	double MaxRegressionPercent = 10.0;
+	FString OutputPath = FPaths::ProjectSavedDir() / TEXT("EvoMaps") / TEXT("Benchmark.json");
+	FString BaselinePath;
+	FString SpawnerClassPath;
+
+	FEvoBenchmarkReport Report;
+	Report.Label = TEXT("Local");
+
+	FParse::Value(Cmd, TEXT("Seeds="), NumSeeds);
+	FParse::Value(Cmd, TEXT("Samples="), NumSamples);
+	FParse::Value(Cmd, TEXT("Warmup="), NumWarmup);
+	FParse::Value(Cmd, TEXT("Mutations="), Mutations);
+	FParse::Value(Cmd, TEXT("MaxRegression="), MaxRegressionPercent);
+	FParse::Value(Cmd, TEXT("Output="), OutputPath);
+	FParse::Value(Cmd, TEXT("Baseline="), BaselinePath);
+	FParse::Value(Cmd, TEXT("SpawnerClass="), SpawnerClassPath);
+	FParse::Value(Cmd, TEXT("Label="), Report.Label);
+	const bool bSpawn = !FParse::Param(Cmd, TEXT("SkipSpawn"));
+
+	if (Sizes.Num() == 0 || NodeCounts.Num() == 0 || NumSeeds <= 0 || NumSamples <= 0 || NumWarmup < 0 || Mutations < 0
+		|| Sizes.ContainsByPredicate([](int32 Size) { return Size <= 0; }) || NodeCounts.ContainsByPredicate([](int32 Count) { return Count < 0; }))
+	{
+		UE_LOG(LogEvoBenchmark, Error, TEXT("Invalid parameters: Seeds=%d Samples=%d Warmup=%d Mutations=%d, Sizes and Nodes need positive entries"), NumSeeds, NumSamples, NumWarmup, Mutations);
+		return 1;
+	}
+
+	FEvoBenchmarkReport Baseline;
+	if (!BaselinePath.IsEmpty())
+	{
+		FString BaselineJson;
+		if (!FFileHelper::LoadFileToString(BaselineJson, *BaselinePath) || !FJsonObjectConverter::JsonObjectStringToUStruct(BaselineJson, &Baseline))
+		{
+			UE_LOG(LogEvoBenchmark, Error, TEXT("Failed to read baseline %s"), *BaselinePath);
+			return 1;
+		}
+	}
+
+	Report.Timestamp = FDateTime::UtcNow().ToIso8601();
+	Report.EngineVersion = FEngineVersion::Current().ToString();
+	Report.BuildConfiguration = LexToString(FApp::GetBuildConfiguration());
+	Report.CPU = FPlatformMisc::GetCPUBrand().TrimStartAndEnd();
+	Report.NumWorkerThreads = FTaskGraphInterface::Get().GetNumWorkerThreads();
+
+	TStrongObjectPtr<UEvoMapGenerator> MapGen(NewObject<UEvoMapGenerator>(GetTransientPackage()));
+
+	// The spawner needs a world for its components
+	UClass* SpawnerClass = AAssetSpawnerVenice::StaticClass();
+	if (!SpawnerClassPath.IsEmpty())
+	{
+		SpawnerClass = LoadClass<AAssetSpawnerVenice>(nullptr, *SpawnerClassPath);
+		if (!SpawnerClass)
+		{
+			UE_LOG(LogEvoBenchmark, Error, TEXT("Failed to load spawner class %s"), *SpawnerClassPath);
+			return 1;
+		}
+	}
+	UWorld* World = UWorld::CreateWorld(EWorldType::Game, false, TEXT("EvoBenchmark"));
+	AAssetSpawnerVenice* Spawner = World->SpawnActor<AAssetSpawnerVenice>(SpawnerClass);
+	Spawner->bSpawnOverFrames = false;
+
+	// Results of the stages, so the calls cannot be optimized away
+	double Sink = 0.0;
+
+	for (const int32 Size : Sizes)
+	{
+		for (const int32 ExtraNodes : NodeCounts)
+		{
+			TMap<FString, FEvoStageSamples> StageSamples;
+
+			// Times Call once per sample. Setup runs untimed before every call, e.g. to restore the input.
+			auto SampleStage = [&](const TCHAR* Stage, int32 ItemsPerCall, TFunctionRef<void()> Setup, TFunctionRef<void()> Call)
+				{
+					FEvoStageSamples& Samples = StageSamples.FindOrAdd(Stage);
+					Samples.ItemsPerCall = ItemsPerCall;
+					for (int32 Sample = -NumWarmup; Sample < NumSamples; Sample++)
+					{
+						Setup();
+						uint64 StartCycles = 0;
+						uint64 EndCycles = 0;
+						{
+							// Lets a -trace=memalloc recording attribute allocations to the stage
+							TRACE_CPUPROFILER_EVENT_SCOPE_TEXT(Stage);
+							StartCycles = FPlatformTime::Cycles64();
+							Call();
+							EndCycles = FPlatformTime::Cycles64();
+						}
+						if (Sample >= 0)
+						{
+							Samples.Seconds.Add(FPlatformTime::ToSeconds64(EndCycles - StartCycles));
+						}
+					}
+				};
+			auto NoSetup = []() {};
+
+			for (int32 Seed = 0; Seed < NumSeeds; Seed++)
+			{
+				FRandomStream SetupStream(Seed);
+				TArray<FEvoGraph> BaseGraphs = MapGen->InitVeniceGraphs(Size, Size, SetupStream);
+				for (FEvoGraph& Graph : BaseGraphs)
+				{
+					Graph = MapGen->AddNodes(Graph, ExtraNodes, {}, true, false, SetupStream);
+					Graph = MapGen->AddEdges(Graph, ExtraNodes, SetupStream);
+				}
+				const FEvoGrid BaseGrid = MapGen->GenerateGridFromGraphs(BaseGraphs);
+				const FEvoAssetMap BaseAssetMap = Spawner->TranslateMap(BaseGrid);
+				const int32 NumTiles = Size * Size;
+
+				FEvoEvaluationParams EvaluationParams;
+				EvaluationParams.TargetStreetTiles = NumTiles / 5;
+				EvaluationParams.TargetCanalTiles = NumTiles / 10;
+				EvaluationParams.TargetStartStartDistance = Size / 2;
+				EvaluationParams.TargetStartDestinationDistance = Size;
+
+				TArray<FEvoGraph> Graphs;
+				FEvoGrid Grid;
+				FEvoAssetMap AssetMap;
+				FRandomStream MutationStream(Seed);
+
+				SampleStage(TEXT("MutateGraphArray"), Mutations, [&]() { Graphs = BaseGraphs; },
+					[&]() { MapGen->MutateGraphArray(Graphs, Mutations, MutationStream); });
+				Sink += Graphs[0].Nodes.Num();
+
+				SampleStage(TEXT("GenerateGridFromGraphs"), NumTiles, NoSetup,
+					[&]() { Grid = MapGen->GenerateGridFromGraphs(BaseGraphs); });
+				SampleStage(TEXT("GenerateGridFromGraphsInto"), NumTiles, NoSetup,
+					[&]() { MapGen->GenerateGridFromGraphsInto(BaseGraphs, Grid); });
+				Sink += Grid.Width;
+
+				SampleStage(TEXT("TileCount.Street"), NumTiles, NoSetup,
+					[&]() { Sink += UEvaluationFunctionLibrary::TileCount(BaseGrid, EEvoTileTag::Street, EvaluationParams.TargetStreetTiles); });
+				SampleStage(TEXT("TileCount.Canal"), NumTiles, NoSetup,
+					[&]() { Sink += UEvaluationFunctionLibrary::TileCount(BaseGrid, EEvoTileTag::Canal, EvaluationParams.TargetCanalTiles); });
+				SampleStage(TEXT("StreetCanalOverlap"), NumTiles, NoSetup,
+					[&]() { Sink += UEvaluationFunctionLibrary::StreetCanalOverlap(BaseGrid); });
+				SampleStage(TEXT("PlayerStartDestinationDistance"), NumTiles, NoSetup,
+					[&]() { Sink += UEvaluationFunctionLibrary::PlayerStartDestinationDistance(BaseGraphs, BaseGrid, EvaluationParams.TargetStartDestinationDistance); });
+				SampleStage(TEXT("StartToStartDistance"), NumTiles, NoSetup,
+					[&]() { Sink += UEvaluationFunctionLibrary::StartToStartDistance(BaseGraphs, BaseGrid, EvaluationParams.TargetStartStartDistance); });
+				SampleStage(TEXT("EvaluateMap"), NumTiles, NoSetup,
+					[&]() { Sink += UEvaluationFunctionLibrary::EvaluateMap(BaseGraphs, BaseGrid, EvaluationParams).Score; });
+
+				SampleStage(TEXT("TranslateMap"), NumTiles, NoSetup,
+					[&]() { AssetMap = Spawner->TranslateMap(BaseGrid); });
+				Sink += AssetMap.Width;
+
+				if (bSpawn)
+				{
+					// Every sample spawns the whole map, the spawner only touches changed tiles otherwise
+					SampleStage(TEXT("SpawnMap"), NumTiles, [&]() { Spawner->ClearMap(); },
+						[&]()
+						{
+							FRandomStream SpawnStream(Seed);
+							Spawner->SpawnMap(BaseAssetMap, SpawnStream);
+						});
+				}
+			}
+			Spawner->ClearMap();
+
+			for (TPair<FString, FEvoStageSamples>& Pair : StageSamples)
+			{
+				FEvoStageSamples& Samples = Pair.Value;
+				Samples.Seconds.Sort();
+
+				double TotalSeconds = 0.0;
+				for (const double Seconds : Samples.Seconds)
+				{
+					TotalSeconds += Seconds;
+				}
+
+				FEvoBenchmarkStageResult& Result = Report.Results.AddDefaulted_GetRef();
+				Result.Stage = Pair.Key;
+				Result.Width = Size;
+				Result.Height = Size;
+				Result.ExtraNodes = ExtraNodes;
+				Result.NumSamples = Samples.Seconds.Num();
+				Result.MedianMicroseconds = Percentile(Samples.Seconds, 0.5) * 1e6;
+				Result.P95Microseconds = Percentile(Samples.Seconds, 0.95) * 1e6;
+				Result.MeanMicroseconds = TotalSeconds / Samples.Seconds.Num() * 1e6;
+				Result.ItemsPerCall = Samples.ItemsPerCall;
+				Result.ItemsPerSecond = Result.MedianMicroseconds > 0.0 ? Samples.ItemsPerCall / (Result.MedianMicroseconds * 1e-6) : 0.0;
+
+				UE_LOG(LogEvoBenchmark, Display, TEXT("%-32s %4dx%-4d +%-5d median %10.1f us  p95 %10.1f us  %12.0f items/s"),
+					*Result.Stage, Size, Size, ExtraNodes, Result.MedianMicroseconds, Result.P95Microseconds, Result.ItemsPerSecond);
+			}
+		}
+	}
+
+	World->DestroyWorld(false);
+	World->RemoveFromRoot();
+	UE_LOG(LogEvoBenchmark, Verbose, TEXT("Sink %f"), Sink);
+
+	FString Json;
+	if (!FJsonObjectConverter::UStructToJsonObjectString(Report, Json) || !FFileHelper::SaveStringToFile(Json, *OutputPath))
+	{
+		UE_LOG(LogEvoBenchmark, Error, TEXT("Failed to write %s"), *OutputPath);
+		return 1;
+	}
+	UE_LOG(LogEvoBenchmark, Display, TEXT("Wrote %d results to %s"), Report.Results.Num(), *OutputPath);
+
+	if (!BaselinePath.IsEmpty() && CompareReports(Baseline, Report, MaxRegressionPercent) > 0)
+	{
+		return 1;
+	}
+	return 0;
+}
+
+int32 UEvoBenchmarkCommandlet::CompareReports(const FEvoBenchmarkReport& Baseline, const FEvoBenchmarkReport& Current, double MaxRegressionPercent)
+{
+	UE_LOG(LogEvoBenchmark, Display, TEXT("Comparing '%s' against baseline '%s'"), *Current.Label, *Baseline.Label);
+
+	int32 NumRegressions = 0;
+	for (const FEvoBenchmarkStageResult& Result : Current.Results)
+	{
+		const FEvoBenchmarkStageResult* BaselineResult = Baseline.Results.FindByPredicate([&Result](const FEvoBenchmarkStageResult& Other)
+			{
+				return Other.Stage == Result.Stage && Other.Width == Result.Width && Other.Height == Result.Height && Other.ExtraNodes == Result.ExtraNodes;
+			});
+		if (!BaselineResult || BaselineResult->MedianMicroseconds <= 0.0)
+		{
+			continue;
+		}
+
+		const double ChangePercent = (Result.MedianMicroseconds / BaselineResult->MedianMicroseconds - 1.0) * 100.0;
+		const bool bRegression = ChangePercent > MaxRegressionPercent;
+		NumRegressions += bRegression ? 1 : 0;
+		if (bRegression)
+		{
+			UE_LOG(LogEvoBenchmark, Warning, TEXT("%-32s %4dx%-4d +%-5d %10.1f us -> %10.1f us (%+.1f%%)"), *Result.Stage, Result.Width, Result.Height, Result.ExtraNodes,
+				BaselineResult->MedianMicroseconds, Result.MedianMicroseconds, ChangePercent);
+		}
+		else
+		{
+			UE_LOG(LogEvoBenchmark, Display, TEXT("%-32s %4dx%-4d +%-5d %10.1f us -> %10.1f us (%+.1f%%)"), *Result.Stage, Result.Width, Result.Height, Result.ExtraNodes,
+				BaselineResult->MedianMicroseconds, Result.MedianMicroseconds, ChangePercent);
+		}
+	}
+
+	if (NumRegressions > 0)
+	{
+		UE_LOG(LogEvoBenchmark, Error, TEXT("%d stages are more than %.1f%% slower than the baseline"), NumRegressions, MaxRegressionPercent);
+	}
+	return NumRegressions;
+}
@@ -0,0 +1,112 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Commandlets/Commandlet.h"
+#include "EvoBenchmarkCommandlet.generated.h"
+
+// Timings of one stage on one grid size and node count, over all seeds and samples
+USTRUCT()
+struct FEvoBenchmarkStageResult
+{
+	GENERATED_BODY()
+
+public:
+	UPROPERTY()
+	FString Stage;
+
+	UPROPERTY()
+	int32 Width = 0;
+
+	UPROPERTY()
+	int32 Height = 0;
+
+	// Free nodes and edges added to each start graph
+	UPROPERTY()
+	int32 ExtraNodes = 0;
+
+	UPROPERTY()
+	int32 NumSamples = 0;
+
+	UPROPERTY()
+	double MedianMicroseconds = 0.0;
+
+	UPROPERTY()
+	double P95Microseconds = 0.0;
+
+	UPROPERTY()
+	double MeanMicroseconds = 0.0;
+
+	// Always -1, allocations are not counted. Replacing GMalloc is unsupported and a process-wide counter would include other threads.
+	// Record the run with -trace=memalloc and compare the stages in the Unreal Insights memory view instead.
+	UPROPERTY()
+	double AllocationsPerCall = -1.0;
+
+	// Mutations for MutateGraphArray, tiles for every other stage
+	UPROPERTY()
+	int32 ItemsPerCall = 0;
+
+	// ItemsPerCall at the median time
+	UPROPERTY()
+	double ItemsPerSecond = 0.0;
+};
+
+// Everything one benchmark run writes to disk
+USTRUCT()
+struct FEvoBenchmarkReport
+{
+	GENERATED_BODY()
+
+public:
+	// Free text to tell revisions apart, e.g. the commit hash
+	UPROPERTY()
+	FString Label;
+
+	UPROPERTY()
+	FString Timestamp;
+
+	UPROPERTY()
+	FString EngineVersion;
+
+	UPROPERTY()
+	FString BuildConfiguration;
+
+	UPROPERTY()
+	FString CPU;
+
+	UPROPERTY()
+	int32 NumWorkerThreads = 0;
+
+	UPROPERTY()
+	TArray<FEvoBenchmarkStageResult> Results;
+};
+
+/**
+ * Times every stage of the generation pipeline in isolation over a matrix of grid sizes, node counts and seeds.
+ *
+ * UnrealEditor-Cmd EvolutionaryMaps.uproject -run=EvoBenchmark -nullrhi -Sizes=64,128,256,512,1024 -Nodes=0,100,1000
+ *     -Seeds=3 -Samples=30 -Warmup=3 -Mutations=20 -Label=<Revision> -Output=<File> [-Baseline=<File> -MaxRegression=10]
+ *     [-SpawnerClass=<Class path>] [-SkipSpawn]
+ *
+ * Stages are MutateGraphArray, GenerateGridFromGraphs, GenerateGridFromGraphsInto, every UEvaluationFunctionLibrary term,
+ * EvaluateMap, TranslateMap and SpawnMap. Every sample calls the stage once on the Venice start graphs of the seed,
+ * with the extra free nodes and edges, and is timed on its own. SpawnMap spawns the whole map into an empty spawner
+ * in a world of its own, without meshes unless SpawnerClass names a Blueprint that sets them.
+ *
+ * The report is written as JSON (default Saved/EvoMaps/Benchmark.json). With -Baseline the medians are compared against
+ * an earlier report and the commandlet fails if any stage got more than MaxRegression percent slower.
+ */
+UCLASS()
+class EVOLUTIONARYMAPS_API UEvoBenchmarkCommandlet : public UCommandlet
+{
+	GENERATED_BODY()
+
+public:
+	UEvoBenchmarkCommandlet();
+
+	virtual int32 Main(const FString& Params) override;
+
+	// Logs the median change of every stage found in both reports, returns the number of stages slower than MaxRegressionPercent
+	static int32 CompareReports(const FEvoBenchmarkReport& Baseline, const FEvoBenchmarkReport& Current, double MaxRegressionPercent);
+};
@@ -0,0 +1,161 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "EvoDistanceEngine.h"
+#include "EvoStats.h"
+#include "EvoMemory.h"
+
+static FCriticalSection GEvoDistanceEnginesLock;
+static TArray<const FEvoDistanceEngine*> GEvoDistanceEngines;
+
+FEvoDistanceEngine::FEvoDistanceEngine()
+{
+	FScopeLock Lock(&GEvoDistanceEnginesLock);
+	GEvoDistanceEngines.Add(this);
+}
+
+FEvoDistanceEngine::~FEvoDistanceEngine()
+{
+	FScopeLock Lock(&GEvoDistanceEnginesLock);
+	GEvoDistanceEngines.RemoveSwap(this);
+}
+
+SIZE_T FEvoDistanceEngine::GetTotalAllocatedSize()
+{
+	FScopeLock Lock(&GEvoDistanceEnginesLock);
+	SIZE_T Size = GEvoDistanceEngines.GetAllocatedSize();
+	for (const FEvoDistanceEngine* Engine : GEvoDistanceEngines)
+	{
+		Size += Engine->PublishedAllocatedSize.load(std::memory_order_relaxed);
+	}
+	return Size;
+}
+
+FEvoDistanceEngine& FEvoDistanceEngine::GetThreadLocal()
+{
+	static thread_local FEvoDistanceEngine Engine;
+	return Engine;
+}
+
+void FEvoDistanceEngine::Prepare(const FEvoGrid& Grid)
+{
+	const int32 NumTiles = Grid.Width * Grid.Height;
+	if (VisitStamps.Num() < NumTiles)
+	{
+		Distances.SetNumUninitialized(NumTiles);
+		Frontier.SetNumUninitialized(NumTiles);
+		VisitStamps.SetNumZeroed(NumTiles);
+		PublishedAllocatedSize.store(GetAllocatedSize(), std::memory_order_relaxed);
+	}
+
+	CurrentStamp++;
+	if (CurrentStamp == 0)
+	{
+		// Stamp wrapped around, old stamps could alias the new one
+		FMemory::Memzero(VisitStamps.GetData(), VisitStamps.Num() * sizeof(uint32));
+		CurrentStamp = 1;
+	}
+}
+
+void FEvoDistanceEngine::DistancesTo(const FEvoGrid& Grid, FIntPoint Root, TConstArrayView<FIntPoint> Targets, TArrayView<int32> OutDistances)
+{
+	SCOPE_CYCLE_COUNTER(STAT_EvoStreetBfs);
+	check(Targets.Num() == OutDistances.Num());
+
+	const int32 Width = Grid.Width;
+	const int32 Height = Grid.Height;
+
+	auto IsInside = [Width, Height](FIntPoint P) -> bool
+		{
+			return P.X >= 0 && P.X < Width && P.Y >= 0 && P.Y < Height;
+		};
+
+	int32 Unresolved = 0;
+	for (int32 i = 0; i < Targets.Num(); i++)
+	{
+		OutDistances[i] = (Targets[i] == Root) ? 0 : -1;
+		if (OutDistances[i] == -1 && IsInside(Targets[i]))
+		{
+			Unresolved++;
+		}
+	}
+
+	// The root is the last tile of every path, so it has to be a Street itself
+	if (Unresolved == 0 || !IsInside(Root) || !Grid.HasTag(Root.X, Root.Y, EEvoTileTag::Street))
+	{
+		return;
+	}
+
+	Prepare(Grid);
+
+	// Resolves targets against a freshly reached tile. BFS assigns distances in non-decreasing order, so the first hit is the shortest.
+	// Street targets are reached by entering them, any other target only needs one Street neighbor on the path.
+	auto ResolveTargets = [&](FIntPoint Tile, int32 Distance)
+		{
+			for (int32 i = 0; i < Targets.Num(); i++)
+			{
+				if (OutDistances[i] != -1 || !IsInside(Targets[i]))
+				{
+					continue;
+				}
+				const FIntPoint& Target = Targets[i];
+				if (Target == Tile)
+				{
+					OutDistances[i] = Distance;
+					Unresolved--;
+				}
+				else if (FMath::Abs(Target.X - Tile.X) + FMath::Abs(Target.Y - Tile.Y) == 1 && !Grid.HasTag(Target.X, Target.Y, EEvoTileTag::Street))
+				{
+					OutDistances[i] = Distance + 1;
+					Unresolved--;
+				}
+			}
+		};
+
+	int32 Head = 0;
+	int32 Tail = 0;
+	const int32 RootIndex = Root.Y * Width + Root.X;
+	VisitStamps[RootIndex] = CurrentStamp;
+	Distances[RootIndex] = 0;
+	Frontier[Tail++] = RootIndex;
+	ResolveTargets(Root, 0);
+
+	while (Head < Tail && Unresolved > 0)
+	{
+		const int32 CurrentIndex = Frontier[Head++];
+		const int32 X = CurrentIndex % Width;
+		const int32 Y = CurrentIndex / Width;
+		const int32 NextDistance = Distances[CurrentIndex] + 1;
+
+		// Explore all 4 possible movements (down, up, right, left)
+		const FIntPoint Neighbors[4] = { FIntPoint(X, Y + 1), FIntPoint(X, Y - 1), FIntPoint(X + 1, Y), FIntPoint(X - 1, Y) };
+		for (const FIntPoint& Neighbor : Neighbors)
+		{
+			if (!IsInside(Neighbor))
+			{
+				continue;
+			}
+
+			const int32 NeighborIndex = Neighbor.Y * Width + Neighbor.X;
+			if (IsVisited(NeighborIndex) || !Grid.HasTag(Neighbor.X, Neighbor.Y, EEvoTileTag::Street))
+			{
+				continue;
+			}
+
+			VisitStamps[NeighborIndex] = CurrentStamp;
+			Distances[NeighborIndex] = NextDistance;
+			Frontier[Tail++] = NeighborIndex;
+			ResolveTargets(Neighbor, NextDistance);
+		}
+	}
+
+	INC_DWORD_STAT_BY(STAT_EvoBfsNodesExpanded, Head);
+	GEvoBfsNodesExpanded.fetch_add(Head, std::memory_order_relaxed);
+}
+
+int32 FEvoDistanceEngine::Distance(const FEvoGrid& Grid, FIntPoint Start, FIntPoint End)
+{
+	int32 Result = -1;
+	DistancesTo(Grid, End, MakeArrayView(&Start, 1), MakeArrayView(&Result, 1));
+	return Result;
+}
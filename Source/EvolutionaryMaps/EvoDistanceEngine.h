@@ -0,0 +1,61 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "EvoStructs.h"
+#include <atomic>
+
+/**
+ * Breadth first search over Street tiles with flat, reusable scratch buffers.
+ * Distances and visit stamps are indexed by Y * Width + X, so a query allocates nothing once the buffers have grown
+ * to the grid size. Use GetThreadLocal() so every worker thread keeps its own scratch across calls.
+ */
+struct EVOLUTIONARYMAPS_API FEvoDistanceEngine
+{
+public:
+	// Engines register themselves so footprint reports can find the scratch of every thread
+	FEvoDistanceEngine();
+	~FEvoDistanceEngine();
+	FEvoDistanceEngine(const FEvoDistanceEngine&) = delete;
+	FEvoDistanceEngine& operator=(const FEvoDistanceEngine&) = delete;
+
+	static FEvoDistanceEngine& GetThreadLocal();
+
+	/**
+	 * One BFS rooted at Root answers every target. OutDistances[i] matches FindShortestDistanceStreet(Grid, Targets[i], Root):
+	 * every tile after the first must be a Street, -1 means unreachable. The search stops as soon as all targets are resolved.
+	 */
+	void DistancesTo(const FEvoGrid& Grid, FIntPoint Root, TConstArrayView<FIntPoint> Targets, TArrayView<int32> OutDistances);
+
+	int32 Distance(const FEvoGrid& Grid, FIntPoint Start, FIntPoint End);
+
+	SIZE_T GetAllocatedSize() const
+	{
+		return Distances.GetAllocatedSize() + VisitStamps.GetAllocatedSize() + Frontier.GetAllocatedSize();
+	}
+
+	// Scratch of every live engine as last published by its owning thread, safe to call while other threads search
+	static SIZE_T GetTotalAllocatedSize();
+
+private:
+	void Prepare(const FEvoGrid& Grid);
+
+	FORCEINLINE bool IsVisited(int32 Index) const
+	{
+		return VisitStamps[Index] == CurrentStamp;
+	}
+
+	// Distance per tile, only valid where VisitStamps matches CurrentStamp
+	TArray<int32> Distances;
+
+	// Bumping CurrentStamp invalidates every tile at once instead of clearing Distances
+	TArray<uint32> VisitStamps;
+	uint32 CurrentStamp = 0;
+
+	// Every tile enters the frontier at most once, so a flat buffer of Width * Height entries never overflows
+	TArray<int32> Frontier;
+
+	// GetAllocatedSize as of the last growth in Prepare, the only value other threads read
+	std::atomic<SIZE_T> PublishedAllocatedSize { 0 };
+};
@@ -0,0 +1,232 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "EvoEvolution.h"
+#include "EvoMapGenerator.h"
+#include "EvaluationFunctionLibrary.h"
+#include "EvoStats.h"
+#include "Async/ParallelFor.h"
+
+void FEvoEvolution::Initialize(UEvoMapGenerator* InMapGen, const FEvoEvolutionSettings& InSettings)
+{
+	MapGen = InMapGen;
+	Settings = InSettings;
+	EvoGraphs.Reset();
+	Offspring.Reset();
+	IterationCounter = 0;
+	IterationsSinceLastIncrease = 0;
+	StatsWindowStartTime = 0.0;
+	StatsWindowIterations = 0;
+	StatsWindowAccepted = 0;
+}
+
+void FEvoEvolution::ResetToVeniceStart()
+{
+	LLM_SCOPE_BYTAG(EvoMaps);
+	check(MapGen);
+	FRandomStream InitStream = MakeSetupStream(StreamInitialGraphs);
+	EvoGraphs = MapGen->InitVeniceGraphs(Settings.Width, Settings.Height, InitStream);
+	IterationCounter = 0;
+	IterationsSinceLastIncrease = 0;
+	RebuildIncumbent();
+}
+
+void FEvoEvolution::RebuildIncumbent()
+{
+	LLM_SCOPE_BYTAG(EvoMaps);
+	TRACE_CPUPROFILER_EVENT_SCOPE(FEvoEvolution::RebuildIncumbent);
+
+	// Graphs replaced from outside may come from UPROPERTY data without an index, the offspring copies need one
+	for (FEvoGraph& Graph : EvoGraphs)
+	{
+		Graph.EnsureIndex();
+	}
+	Offspring.SetNum(FMath::Max(1, Settings.OffspringPerIteration));
+	Offspring[0].Rasterizer.Rebuild(EvoGraphs);
+	for (int32 i = 0; i < Offspring.Num(); i++)
+	{
+		Offspring[i].Graphs = EvoGraphs;
+		Offspring[i].Log.Reset();
+		if (i > 0)
+		{
+			Offspring[i].Rasterizer = Offspring[0].Rasterizer;
+		}
+	}
+
+	IncumbentGrid = Offspring[0].Rasterizer.GetGrid();
+	IncumbentDirtyRect = FIntRect(0, 0, IncumbentGrid.Width, IncumbentGrid.Height);
+	UEvaluationFunctionLibrary::GatherKeyPoints(EvoGraphs, IncumbentKeyPoints);
+	UEvaluationFunctionLibrary::EvaluateMapInto(IncumbentKeyPoints, IncumbentGrid, Settings.EvaluationParams, IncumbentFitness);
+}
+
+bool FEvoEvolution::StepIteration()
+{
+	LLM_SCOPE_BYTAG(EvoMaps);
+	SCOPE_CYCLE_COUNTER(STAT_EvoStepIteration);
+	const double StartTime = FPlatformTime::Seconds();
+	IterationCounter++;
+
+	if (Offspring.Num() != FMath::Max(1, Settings.OffspringPerIteration))
+	{
+		RebuildIncumbent();
+	}
+	const int32 NumOffspring = Offspring.Num();
+	const EParallelForFlags ParallelFlags = (NumOffspring > 1) ? EParallelForFlags::None : EParallelForFlags::ForceSingleThread;
+
+	// Each offspring mutates with its own stream, then only the tiles touched by the mutations are redrawn
+	const FEvoEvaluationParams& Params = Settings.EvaluationParams;
+	ParallelFor(NumOffspring, [this, &Params](int32 Index)
+		{
+			LLM_SCOPE_BYTAG(EvoMaps);
+			FEvoOffspring& Child = Offspring[Index];
+			const double ChildStartTime = FPlatformTime::Seconds();
+			Child.RandomStream.Initialize(DeriveStreamSeed(Settings.Seed, IterationCounter, Index));
+			Child.Log.Reset();
+			MapGen->MutateGraphArray(Child.Graphs, Settings.MutationsPerIteration, Child.RandomStream, &Child.Log);
+			const double ChildMutatedTime = FPlatformTime::Seconds();
+			Child.Rasterizer.ResetDirtyRect();
+			Child.Rasterizer.ApplyDeltas(Child.Log.RasterDeltas);
+			const double ChildRasterizedTime = FPlatformTime::Seconds();
+			Child.bKeyPointsChanged = Child.Log.TouchesKeyNodes();
+			if (Child.bKeyPointsChanged)
+			{
+				UEvaluationFunctionLibrary::GatherKeyPoints(Child.Graphs, Child.KeyPoints);
+			}
+			UEvaluationFunctionLibrary::EvaluateMapInto(Child.bKeyPointsChanged ? Child.KeyPoints : IncumbentKeyPoints, Child.Rasterizer.GetGrid(), Params, Child.Fitness);
+			Child.MutateSeconds = ChildMutatedTime - ChildStartTime;
+			Child.RasterizeSeconds = ChildRasterizedTime - ChildMutatedTime;
+			Child.EvaluateSeconds = FPlatformTime::Seconds() - ChildRasterizedTime;
+		}, ParallelFlags);
+	const double EvaluateEndTime = FPlatformTime::Seconds();
+
+	if (Settings.bValidateIncrementalRaster)
+	{
+		for (const FEvoOffspring& Child : Offspring)
+		{
+			MapGen->GenerateGridFromGraphsInto(Child.Graphs, ValidationGrid);
+			ensureMsgf(Child.Rasterizer.Matches(ValidationGrid), TEXT("Incremental raster diverged from full rebuild after %d Iterations"), IterationCounter);
+		}
+	}
+
+	// Best of lambda, the first one wins ties
+	int32 BestIndex = 0;
+	for (int32 i = 1; i < NumOffspring; i++)
+	{
+		if (Offspring[i].Fitness.Score > Offspring[BestIndex].Fitness.Score)
+		{
+			BestIndex = i;
+		}
+	}
+	LastOffspringScore = Offspring[BestIndex].Fitness.Score;
+	const bool bAccepted = LastOffspringScore >= IncumbentFitness.Score;
+
+	LastTimings.MutateSeconds = 0.0;
+	LastTimings.RasterizeSeconds = 0.0;
+	LastTimings.EvaluateSeconds = 0.0;
+	for (const FEvoOffspring& Child : Offspring)
+	{
+		LastTimings.MutateSeconds += Child.MutateSeconds;
+		LastTimings.RasterizeSeconds += Child.RasterizeSeconds;
+		LastTimings.EvaluateSeconds += Child.EvaluateSeconds;
+	}
+
+	// Move every other offspring back to the incumbent, which is the winner if it was accepted
+	ParallelFor(NumOffspring, [this, BestIndex, bAccepted](int32 Index)
+		{
+			LLM_SCOPE_BYTAG(EvoMaps);
+			if (bAccepted && Index == BestIndex)
+			{
+				return;
+			}
+			FEvoOffspring& Child = Offspring[Index];
+			Child.Log.Undo(Child.Graphs);
+			Child.Rasterizer.RevertDeltas(Child.Log.RasterDeltas);
+			if (bAccepted)
+			{
+				const FEvoMutationLog& BestLog = Offspring[BestIndex].Log;
+				BestLog.Replay(Child.Graphs);
+				Child.Rasterizer.ApplyDeltas(BestLog.RasterDeltas);
+			}
+		}, ParallelFlags);
+
+	if (bAccepted)
+	{
+		FEvoOffspring& Best = Offspring[BestIndex];
+		Best.Log.Replay(EvoGraphs);
+		IncumbentGrid = Best.Rasterizer.GetGrid();
+		FEvoIncrementalRasterizer::UnionRect(IncumbentDirtyRect, Best.Rasterizer.GetDirtyRect());
+		Swap(IncumbentFitness, Best.Fitness);
+		if (Best.bKeyPointsChanged)
+		{
+			Swap(IncumbentKeyPoints, Best.KeyPoints);
+		}
+		IterationsSinceLastIncrease = 0;
+	}
+	else
+	{
+		IterationsSinceLastIncrease++;
+	}
+
+	const double EndTime = FPlatformTime::Seconds();
+	LastTimings.SelectSeconds = EndTime - EvaluateEndTime;
+	LastTimings.TotalSeconds = EndTime - StartTime;
+	PublishStats(bAccepted, EndTime);
+	return bAccepted;
+}
+
+void FEvoEvolution::PublishStats(bool bAccepted, double Now)
+{
+	if (StatsWindowIterations == 0)
+	{
+		StatsWindowStartTime = Now - LastTimings.TotalSeconds;
+	}
+	StatsWindowIterations++;
+	StatsWindowAccepted += bAccepted ? 1 : 0;
+
+	const double WindowSeconds = Now - StatsWindowStartTime;
+	if (WindowSeconds < 0.25)
+	{
+		return;
+	}
+
+	const float IterationsPerSecond = StatsWindowIterations / WindowSeconds;
+	const float AcceptanceRate = static_cast<float>(StatsWindowAccepted) / StatsWindowIterations;
+	SET_FLOAT_STAT(STAT_EvoIterationsPerSecond, IterationsPerSecond);
+	SET_FLOAT_STAT(STAT_EvoAcceptanceRate, AcceptanceRate);
+	SET_FLOAT_STAT(STAT_EvoFitness, IncumbentFitness.Score);
+	TRACE_COUNTER_SET(EvoMaps_IterationsPerSecond, IterationsPerSecond);
+	TRACE_COUNTER_SET(EvoMaps_AcceptanceRate, AcceptanceRate);
+	TRACE_COUNTER_SET(EvoMaps_Fitness, IncumbentFitness.Score);
+	TRACE_COUNTER_SET(EvoMaps_BfsNodesExpanded, GEvoBfsNodesExpanded.load(std::memory_order_relaxed));
+
+	StatsWindowIterations = 0;
+	StatsWindowAccepted = 0;
+}
+
+void FEvoEvolution::GetMemoryFootprint(FEvoMemoryFootprint& Footprint) const
+{
+	Footprint.Graphs += EvoGetDeepAllocatedSize(EvoGraphs);
+	Footprint.Grids += IncumbentGrid.GetAllocatedSize() + ValidationGrid.GetAllocatedSize();
+	Footprint.Other += IncumbentFitness.GetAllocatedSize() + IncumbentKeyPoints.GetAllocatedSize() + Offspring.GetAllocatedSize();
+	for (const FEvoOffspring& Child : Offspring)
+	{
+		Child.GetMemoryFootprint(Footprint);
+	}
+}
+
+// SplitMix64 step, consecutive inputs give unrelated outputs
+static uint64 MixStreamSeed(uint64 Value)
+{
+	Value += 0x9E3779B97F4A7C15ull;
+	Value = (Value ^ (Value >> 30)) * 0xBF58476D1CE4E5B9ull;
+	Value = (Value ^ (Value >> 27)) * 0x94D049BB133111EBull;
+	return Value ^ (Value >> 31);
+}
+
+int32 FEvoEvolution::DeriveStreamSeed(int32 RunSeed, int32 Generation, int32 Index)
+{
+	uint64 Value = MixStreamSeed(static_cast<uint32>(RunSeed));
+	Value = MixStreamSeed(Value ^ static_cast<uint32>(Generation));
+	Value = MixStreamSeed(Value ^ static_cast<uint32>(Index));
+	return static_cast<int32>(static_cast<uint32>(Value));
+}
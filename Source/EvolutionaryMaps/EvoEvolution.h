@@ -0,0 +1,146 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "EvoStructs.h"
+#include "EvoIncrementalRasterizer.h"
+#include "EvoMemory.h"
+
+class UEvoMapGenerator;
+
+struct FEvoEvolutionSettings
+{
+	int32 Width = 64;
+	int32 Height = 64;
+	int32 MutationsPerIteration = 20;
+
+	// Offspring per generation (lambda)
+	int32 OffspringPerIteration = 1;
+
+	// Checks every incremental raster against a full GenerateGridFromGraphs rebuild
+	bool bValidateIncrementalRaster = false;
+
+	// Every random choice of the run is derived from this, the same seed and settings give the same map
+	int32 Seed = 0;
+
+	FEvoEvaluationParams EvaluationParams;
+};
+
+// Wall-clock seconds spent in each stage of the last StepIteration. Mutate, Rasterize and Evaluate are summed over all offspring.
+struct FEvoStageTimings
+{
+	double MutateSeconds = 0.0;
+	double RasterizeSeconds = 0.0;
+	double EvaluateSeconds = 0.0;
+	double SelectSeconds = 0.0;
+	double TotalSeconds = 0.0;
+};
+
+// One candidate of a (1+lambda) generation, with its own graphs and rasterizer so candidates can be mutated and evaluated in parallel
+struct FEvoOffspring
+{
+	// Both kept in sync with the incumbent between generations. Mutations are applied in place and rolled back with Log.
+	TArray<FEvoGraph> Graphs;
+	FEvoIncrementalRasterizer Rasterizer;
+
+	FEvoMutationLog Log;
+
+	FEvoFitness Fitness;
+
+	// Only gathered when the mutations touched a PlayerStart or Destination node, the incumbent's are used otherwise
+	FEvoKeyPoints KeyPoints;
+	bool bKeyPointsChanged = false;
+
+	// Reseeded per generation from the run seed, so the result does not depend on which worker runs this offspring
+	FRandomStream RandomStream;
+
+	double MutateSeconds = 0.0;
+	double RasterizeSeconds = 0.0;
+	double EvaluateSeconds = 0.0;
+
+	void GetMemoryFootprint(FEvoMemoryFootprint& Footprint) const
+	{
+		Footprint.Graphs += EvoGetDeepAllocatedSize(Graphs);
+		Footprint.Grids += Rasterizer.GetAllocatedSize();
+		Footprint.Other += Log.GetAllocatedSize() + Fitness.GetAllocatedSize() + KeyPoints.GetAllocatedSize();
+	}
+};
+
+/**
+ * The (1+lambda) evolution loop without any world or actor, shared by AEvoVenice and UEvoMapCommandlet.
+ * MapGen is not owned, the caller keeps it alive.
+ */
+class EVOLUTIONARYMAPS_API FEvoEvolution
+{
+public:
+	void Initialize(UEvoMapGenerator* InMapGen, const FEvoEvolutionSettings& InSettings);
+
+	// Replaces the current graphs with the Venice start graphs and rebuilds the incumbent
+	void ResetToVeniceStart();
+
+	// Rebuilds the incumbent cache from EvoGraphs, needed whenever EvoGraphs is replaced from outside StepIteration
+	void RebuildIncumbent();
+
+	// Mutates, rasterizes and scores OffspringPerIteration offspring against the cached incumbent. Returns true if the best was accepted.
+	bool StepIteration();
+
+	// Seed of an independent sub-stream of the run. Generation 0 is reserved for setup, see the Stream* indices below.
+	static int32 DeriveStreamSeed(int32 RunSeed, int32 Generation, int32 Index);
+
+	// Sub-streams of generation 0
+	static constexpr int32 StreamInitialGraphs = 0;
+	static constexpr int32 StreamAssetSpawn = 1;
+
+	// Island i of FEvoIslandEvolution runs with the seed of sub-stream StreamIslandBase + i
+	static constexpr int32 StreamIslandBase = 2;
+
+	// Adds the incumbent, the offspring scratch and the validation grid, not the shared distance engines
+	void GetMemoryFootprint(FEvoMemoryFootprint& Footprint) const;
+
+	// Stream for consumers of the finished map, e.g. AAssetSpawnerVenice::SpawnMap
+	FRandomStream MakeSetupStream(int32 StreamIndex) const
+	{
+		return FRandomStream(DeriveStreamSeed(Settings.Seed, 0, StreamIndex));
+	}
+
+	FEvoEvolutionSettings Settings;
+
+	TArray<FEvoGraph> EvoGraphs;
+
+	// Grid and fitness of the accepted EvoGraphs. Only offspring are rasterized and scored, the cache is swapped on acceptance.
+	FEvoGrid IncumbentGrid;
+	FEvoFitness IncumbentFitness;
+
+	// Tiles of IncumbentGrid that changed since the consumer last reset it, e.g. after redrawing
+	FIntRect IncumbentDirtyRect;
+
+	int32 IterationCounter = 0;
+	int32 IterationsSinceLastIncrease = 0;
+
+	// Score of the best offspring of the last generation, accepted or not
+	float LastOffspringScore = 0.0f;
+
+	FEvoStageTimings LastTimings;
+
+private:
+	// Updates the EvoMaps rate and fitness stats once the current window is long enough
+	void PublishStats(bool bAccepted, double Now);
+
+	UEvoMapGenerator* MapGen = nullptr;
+
+	// PlayerStart and Destination locations of EvoGraphs, shared read-only by every offspring that did not move them
+	FEvoKeyPoints IncumbentKeyPoints;
+
+	// Scratch for the current generation, kept alive so its buffers are reused between iterations.
+	// Each offspring holds a copy of the incumbent's graphs and tile coverage, its mutations are applied on top and undone on rejection.
+	TArray<FEvoOffspring> Offspring;
+
+	// Full rebuild of the offspring, only used by bValidateIncrementalRaster
+	FEvoGrid ValidationGrid;
+
+	// Iterations and acceptances since the stats were last published
+	double StatsWindowStartTime = 0.0;
+	int32 StatsWindowIterations = 0;
+	int32 StatsWindowAccepted = 0;
+};
@@ -0,0 +1,98 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "EvoEvolveAsyncAction.h"
+#include "Engine/TextureRenderTarget2D.h"
+
+UEvoEvolveVeniceAsyncAction* UEvoEvolveVeniceAsyncAction::EvolveVeniceMapAsync(UObject* WorldContextObject, TSubclassOf<UEvoMapGenerator> MapGenClass, FEvoEvaluationParams EvaluationParams, UTextureRenderTarget2D* PreviewRenderTarget,
+	int32 Width, int32 Height, int32 MaximumIterations, int32 MutationsPerIteration, int32 OffspringPerIteration, int32 Seed)
+{
+	UEvoEvolveVeniceAsyncAction* Action = NewObject<UEvoEvolveVeniceAsyncAction>();
+	UClass* GeneratorClass = MapGenClass ? MapGenClass.Get() : UEvoMapGenerator::StaticClass();
+	Action->MapGen = NewObject<UEvoMapGenerator>(Action, GeneratorClass);
+	Action->PreviewRenderTarget = PreviewRenderTarget;
+	Action->WorldContextObject = WorldContextObject;
+
+	FEvoEvolutionSettings& Settings = Action->Params.Settings;
+	Settings.Width = FMath::Max(1, Width);
+	Settings.Height = FMath::Max(1, Height);
+	Settings.MutationsPerIteration = MutationsPerIteration;
+	Settings.OffspringPerIteration = FMath::Max(1, OffspringPerIteration);
+	Settings.Seed = Seed;
+	Settings.EvaluationParams = EvaluationParams;
+	Action->Params.MaximumIterations = MaximumIterations;
+
+	Action->RegisterWithGameInstance(WorldContextObject);
+	return Action;
+}
+
+void UEvoEvolveVeniceAsyncAction::Activate()
+{
+	AsyncEvolution = FEvoAsyncEvolution::Launch(MapGen, Params,
+		FEvoAsyncEvolution::FOnProgress::CreateUObject(this, &UEvoEvolveVeniceAsyncAction::HandleProgress),
+		FEvoAsyncEvolution::FOnCompleted::CreateUObject(this, &UEvoEvolveVeniceAsyncAction::HandleCompleted));
+}
+
+void UEvoEvolveVeniceAsyncAction::Cancel()
+{
+	if (AsyncEvolution)
+	{
+		AsyncEvolution->Cancel();
+	}
+}
+
+void UEvoEvolveVeniceAsyncAction::BeginDestroy()
+{
+	// The worker still uses MapGen, it has to be done before this object and MapGen go away
+	if (AsyncEvolution)
+	{
+		AsyncEvolution->Cancel();
+		AsyncEvolution->Wait();
+		AsyncEvolution.Reset();
+	}
+	Super::BeginDestroy();
+}
+
+void UEvoEvolveVeniceAsyncAction::HandleProgress(int32 Iteration, const FEvoFitness& Fitness)
+{
+	LLM_SCOPE_BYTAG(EvoMaps);
+	DrawPreview();
+	OnProgress.Broadcast(Iteration, Fitness);
+}
+
+void UEvoEvolveVeniceAsyncAction::HandleCompleted(const FEvoAsyncEvolution* Sender, const FEvoEvolutionSnapshot& InResult, bool bCancelled)
+{
+	LLM_SCOPE_BYTAG(EvoMaps);
+	if (Sender != AsyncEvolution.Get())
+	{
+		return;
+	}
+	Result = InResult;
+	AsyncEvolution.Reset();
+	if (PreviewRenderTarget)
+	{
+		MapGen->DrawGridToRenderTarget(WorldContextObject.Get(), Result.Grid, PreviewRenderTarget);
+	}
+
+	if (bCancelled)
+	{
+		OnCancelled.Broadcast(Result.Iteration, Result.Fitness);
+	}
+	else
+	{
+		OnCompleted.Broadcast(Result.Iteration, Result.Fitness);
+	}
+	SetReadyToDestroy();
+}
+
+void UEvoEvolveVeniceAsyncAction::DrawPreview()
+{
+	if (!PreviewRenderTarget || !AsyncEvolution)
+	{
+		return;
+	}
+	if (const FEvoEvolutionSnapshot* Snapshot = AsyncEvolution->PollSnapshot())
+	{
+		MapGen->DrawGridToRenderTarget(WorldContextObject.Get(), Snapshot->Grid, PreviewRenderTarget);
+	}
+}
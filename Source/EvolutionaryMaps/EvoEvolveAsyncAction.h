@@ -0,0 +1,85 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Kismet/BlueprintAsyncActionBase.h"
+#include "EvoStructs.h"
+#include "EvoMapGenerator.h"
+#include "EvoAsyncEvolution.h"
+#include "EvoEvolveAsyncAction.generated.h"
+
+class UTextureRenderTarget2D;
+
+DECLARE_DYNAMIC_MULTICAST_DELEGATE_TwoParams(FEvoEvolveAsyncPin, int32, Iteration, const FEvoFitness&, Fitness);
+
+/**
+ * "Evolve Venice Map Async" node. Runs the whole evolution on a background task and reports back on the game thread.
+ * The evolved map is read from the returned action with GetResultMap once a completion pin fired.
+ */
+UCLASS()
+class EVOLUTIONARYMAPS_API UEvoEvolveVeniceAsyncAction : public UBlueprintAsyncActionBase
+{
+	GENERATED_BODY()
+
+public:
+	// PreviewRenderTarget is optional and redrawn whenever a new best map is published
+	UFUNCTION(BlueprintCallable, Category = "EvoMaps", meta = (BlueprintInternalUseOnly = "true", WorldContext = "WorldContextObject", DisplayName = "Evolve Venice Map Async"))
+	static UEvoEvolveVeniceAsyncAction* EvolveVeniceMapAsync(UObject* WorldContextObject, TSubclassOf<UEvoMapGenerator> MapGenClass, FEvoEvaluationParams EvaluationParams, UTextureRenderTarget2D* PreviewRenderTarget,
+		int32 Width = 64, int32 Height = 64, int32 MaximumIterations = 1000, int32 MutationsPerIteration = 20, int32 OffspringPerIteration = 1, int32 Seed = 0);
+
+	// Stops the run after the iteration in progress, Cancelled fires with the best map so far
+	UFUNCTION(BlueprintCallable, Category = "EvoMaps")
+	void Cancel();
+
+	UPROPERTY(BlueprintAssignable)
+	FEvoEvolveAsyncPin OnProgress;
+
+	UPROPERTY(BlueprintAssignable)
+	FEvoEvolveAsyncPin OnCompleted;
+
+	UPROPERTY(BlueprintAssignable)
+	FEvoEvolveAsyncPin OnCancelled;
+
+	// Graphs and grid of the finished run, valid once OnCompleted or OnCancelled fired
+	const FEvoEvolutionSnapshot& GetResult() const
+	{
+		return Result;
+	}
+
+	// Blueprint access to GetResult, empty until OnCompleted or OnCancelled fired
+	UFUNCTION(BlueprintPure, Category = "EvoMaps")
+	void GetResultMap(TArray<FEvoGraph>& Graphs, FEvoGrid& Grid, FEvoFitness& Fitness, int32& Seed) const
+	{
+		Graphs = Result.Graphs;
+		Grid = Result.Grid;
+		Fitness = Result.Fitness;
+		Seed = Result.Seed;
+	}
+
+	// UBlueprintAsyncActionBase
+	virtual void Activate() override;
+
+	// UObject
+	virtual void BeginDestroy() override;
+
+private:
+	void HandleProgress(int32 Iteration, const FEvoFitness& Fitness);
+	void HandleCompleted(const FEvoAsyncEvolution* Sender, const FEvoEvolutionSnapshot& InResult, bool bCancelled);
+
+	// Draws the newest published snapshot, if any
+	void DrawPreview();
+
+	UPROPERTY()
+	UEvoMapGenerator* MapGen = nullptr;
+
+	UPROPERTY()
+	UTextureRenderTarget2D* PreviewRenderTarget = nullptr;
+
+	// The action lives in the transient package, drawing needs the caller's world
+	TWeakObjectPtr<UObject> WorldContextObject;
+
+	FEvoAsyncEvolutionParams Params;
+	TSharedPtr<FEvoAsyncEvolution, ESPMode::ThreadSafe> AsyncEvolution;
+	FEvoEvolutionSnapshot Result;
+};
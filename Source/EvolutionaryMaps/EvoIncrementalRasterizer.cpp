@@ -0,0 +1,172 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "EvoIncrementalRasterizer.h"
+#include "EvoStats.h"
+
+void FEvoIncrementalRasterizer::Rebuild(const TArray<FEvoGraph>& InGraphs)
+{
+	TRACE_CPUPROFILER_EVENT_SCOPE(FEvoIncrementalRasterizer::Rebuild);
+	TArray<FEvoGraph> IndexedCopy;
+	const TArray<FEvoGraph>& Graphs = FEvoGraph::GetIndexed(InGraphs, IndexedCopy);
+	if (Graphs.Num() == 0)
+	{
+		Grid = FEvoGrid();
+		CoverageBlocks.Reset();
+		ResetDirtyRect();
+		return;
+	}
+
+	Grid.Initialize(Graphs[0].GridSize.X, Graphs[0].GridSize.Y);
+	CoverageBlocks.Reset();
+	CoverageBlocks.SetNum(Grid.BlockCounts.Num());
+
+	for (const FEvoGraph& Graph : Graphs)
+	{
+		for (const FEvoNode& Node : Graph.Nodes)
+		{
+			if (Node.AdditonalTags.Num() > 0)
+			{
+				ApplyDelta(FEvoRasterDelta::ForNode(Node, true), true);
+			}
+		}
+		for (const FEvoEdge& Edge : Graph.Edges)
+		{
+			ApplyDelta(Graph.MakeEdgeDelta(Edge, true), true);
+		}
+	}
+
+	DirtyRect = FIntRect(0, 0, Grid.Width, Grid.Height);
+}
+
+void FEvoIncrementalRasterizer::ApplyDeltas(TConstArrayView<FEvoRasterDelta> Deltas)
+{
+	SCOPE_CYCLE_COUNTER(STAT_EvoIncrementalRaster);
+	for (const FEvoRasterDelta& Delta : Deltas)
+	{
+		ApplyDelta(Delta, Delta.bAdd);
+	}
+}
+
+void FEvoIncrementalRasterizer::RevertDeltas(TConstArrayView<FEvoRasterDelta> Deltas)
+{
+	SCOPE_CYCLE_COUNTER(STAT_EvoIncrementalRaster);
+	for (int32 i = Deltas.Num() - 1; i >= 0; i--)
+	{
+		ApplyDelta(Deltas[i], !Deltas[i].bAdd);
+	}
+}
+
+bool FEvoIncrementalRasterizer::Matches(const FEvoGrid& Reference) const
+{
+	return Grid.Width == Reference.Width && Grid.Height == Reference.Height && Grid.TagBits == Reference.TagBits && Grid.BlockCounts == Reference.BlockCounts;
+}
+
+void FEvoIncrementalRasterizer::ApplyDelta(const FEvoRasterDelta& Delta, bool bAdd)
+{
+	for (int32 TagIndex = 0; TagIndex < FEvoGrid::NumTileTags; TagIndex++)
+	{
+		if ((Delta.TagMask & (1 << TagIndex)) == 0)
+		{
+			continue;
+		}
+		const EEvoTileTag Tag = static_cast<EEvoTileTag>(TagIndex);
+
+		if (!Delta.bIsEdge)
+		{
+			Cover(Delta.Start.X, Delta.Start.Y, Tag, bAdd);
+			continue;
+		}
+
+		// Same clamping and L shape as UEvoMapGenerator::GenerateGridFromGraphs
+		FIntPoint Start = Delta.Start;
+		FIntPoint End = Delta.End;
+		Start.X = FMath::Clamp(Start.X, 0, Grid.Width - 1);
+		Start.Y = FMath::Clamp(Start.Y, 0, Grid.Height - 1);
+		End.X = FMath::Clamp(End.X, 0, Grid.Width - 1);
+		End.Y = FMath::Clamp(End.Y, 0, Grid.Height - 1);
+
+		const int32 MinX = FMath::Min(Start.X, End.X);
+		const int32 MaxX = FMath::Max(Start.X, End.X);
+		const int32 MinY = FMath::Min(Start.Y, End.Y);
+		const int32 MaxY = FMath::Max(Start.Y, End.Y);
+
+		if (Delta.EdgeType == EEvoEdgeType::HorizontalFirst)
+		{
+			CoverSpanX(MinX, MaxX, Start.Y, Tag, bAdd);
+			CoverSpanY(End.X, MinY, MaxY, Tag, bAdd);
+		}
+		else
+		{
+			CoverSpanY(Start.X, MinY, MaxY, Tag, bAdd);
+			CoverSpanX(MinX, MaxX, End.Y, Tag, bAdd);
+		}
+	}
+}
+
+void FEvoIncrementalRasterizer::CoverSpanX(int32 MinX, int32 MaxX, int32 Y, EEvoTileTag Tag, bool bAdd)
+{
+	for (int32 X = MinX; X <= MaxX; ++X)
+	{
+		Cover(X, Y, Tag, bAdd);
+	}
+}
+
+void FEvoIncrementalRasterizer::CoverSpanY(int32 X, int32 MinY, int32 MaxY, EEvoTileTag Tag, bool bAdd)
+{
+	for (int32 Y = MinY; Y <= MaxY; ++Y)
+	{
+		Cover(X, Y, Tag, bAdd);
+	}
+}
+
+void FEvoIncrementalRasterizer::Cover(int32 X, int32 Y, EEvoTileTag Tag, bool bAdd)
+{
+	const int32 Word = X / FEvoGrid::BitsPerWord;
+	TArray<uint16>& Block = CoverageBlocks[Grid.GetBlockIndex(Tag, Word, Y)];
+	if (Block.Num() == 0)
+	{
+		check(bAdd);
+		Block.SetNumZeroed(FEvoGrid::BlockRows * FEvoGrid::BitsPerWord);
+	}
+	uint16& Count = Block[(Y % FEvoGrid::BlockRows) * FEvoGrid::BitsPerWord + X % FEvoGrid::BitsPerWord];
+
+	if (bAdd)
+	{
+		check(Count < MAX_uint16);
+		if (Count++ != 0)
+		{
+			return;
+		}
+		Grid.AddTileTag(X, Y, Tag);
+	}
+	else
+	{
+		check(Count > 0);
+		if (--Count != 0)
+		{
+			return;
+		}
+		Grid.RemoveTileTag(X, Y, Tag);
+	}
+
+	// The tag bit flipped, grow the dirty region
+	UnionRect(DirtyRect, FIntRect(X, Y, X + 1, Y + 1));
+}
+
+void FEvoIncrementalRasterizer::UnionRect(FIntRect& Into, const FIntRect& Other)
+{
+	if (Other.Area() <= 0)
+	{
+		return;
+	}
+	if (Into.Area() <= 0)
+	{
+		Into = Other;
+		return;
+	}
+	Into.Min.X = FMath::Min(Into.Min.X, Other.Min.X);
+	Into.Min.Y = FMath::Min(Into.Min.Y, Other.Min.Y);
+	Into.Max.X = FMath::Max(Into.Max.X, Other.Max.X);
+	Into.Max.Y = FMath::Max(Into.Max.Y, Other.Max.Y);
+}
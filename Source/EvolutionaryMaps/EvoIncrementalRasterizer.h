@@ -0,0 +1,75 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "EvoStructs.h"
+
+/**
+ * Keeps an FEvoGrid in sync with a graph array by counting, per tile and per tag, how many nodes and edges cover it.
+ * A tag bit is set while its count is above zero, so mutation deltas can be applied and reverted without redrawing
+ * the whole grid. Produces the same grid as UEvoMapGenerator::GenerateGridFromGraphs.
+ */
+class EVOLUTIONARYMAPS_API FEvoIncrementalRasterizer
+{
+public:
+	// Full rebuild from every node and edge
+	void Rebuild(const TArray<FEvoGraph>& Graphs);
+
+	void ApplyDeltas(TConstArrayView<FEvoRasterDelta> Deltas);
+
+	// Undoes ApplyDeltas with the same list, walking it backwards
+	void RevertDeltas(TConstArrayView<FEvoRasterDelta> Deltas);
+
+	const FEvoGrid& GetGrid() const
+	{
+		return Grid;
+	}
+
+	// Tiles whose tags changed since the last ResetDirtyRect, Max is exclusive. Empty if nothing changed.
+	const FIntRect& GetDirtyRect() const
+	{
+		return DirtyRect;
+	}
+
+	bool HasDirtyRect() const
+	{
+		return DirtyRect.Area() > 0;
+	}
+
+	void ResetDirtyRect()
+	{
+		DirtyRect = FIntRect();
+	}
+
+	// Grows Into to also cover Other, empty rects are ignored
+	static void UnionRect(FIntRect& Into, const FIntRect& Other);
+
+	// Validation mode, compares the incremental result against a grid built from scratch
+	bool Matches(const FEvoGrid& Reference) const;
+
+	// Grid plus the coverage blocks
+	SIZE_T GetAllocatedSize() const
+	{
+		SIZE_T Size = Grid.GetAllocatedSize() + CoverageBlocks.GetAllocatedSize();
+		for (const TArray<uint16>& Block : CoverageBlocks)
+		{
+			Size += Block.GetAllocatedSize();
+		}
+		return Size;
+	}
+
+private:
+	void ApplyDelta(const FEvoRasterDelta& Delta, bool bAdd);
+	void CoverSpanX(int32 MinX, int32 MaxX, int32 Y, EEvoTileTag Tag, bool bAdd);
+	void CoverSpanY(int32 X, int32 MinY, int32 MaxY, EEvoTileTag Tag, bool bAdd);
+	void Cover(int32 X, int32 Y, EEvoTileTag Tag, bool bAdd);
+
+	FEvoGrid Grid;
+
+	// Coverage counts per tag and grid summary block, laid out like FEvoGrid::BlockCounts.
+	// A block holds [Y % BlockRows][X % BitsPerWord] and is only allocated once something covers it.
+	TArray<TArray<uint16>> CoverageBlocks;
+
+	FIntRect DirtyRect;
+};
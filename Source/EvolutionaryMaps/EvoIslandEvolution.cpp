@@ -0,0 +1,164 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "EvoIslandEvolution.h"
+#include "EvoStats.h"
+#include "Async/ParallelFor.h"
+
+void FEvoIslandEvolution::Initialize(UEvoMapGenerator* InMapGen, const FEvoEvolutionSettings& InSettings, const FEvoIslandSettings& InIslandSettings)
+{
+	LLM_SCOPE_BYTAG(EvoMaps);
+	IslandSettings = InIslandSettings;
+	const int32 NumIslands = FMath::Max(1, IslandSettings.NumIslands);
+
+	Islands.Reset();
+	for (int32 IslandIndex = 0; IslandIndex < NumIslands; IslandIndex++)
+	{
+		// A single island is the plain run and keeps its seed
+		FEvoEvolutionSettings IslandEvolutionSettings = InSettings;
+		IslandEvolutionSettings.Seed = (NumIslands > 1) ? GetIslandSeed(InSettings.Seed, IslandIndex) : InSettings.Seed;
+
+		TUniquePtr<FIsland>& Island = Islands.Add_GetRef(MakeUnique<FIsland>());
+		Island->Evolution.Initialize(InMapGen, IslandEvolutionSettings);
+		Island->Evolution.ResetToVeniceStart();
+	}
+}
+
+void FEvoIslandEvolution::Run(int32 MaximumIterations, TFunction<bool()> ShouldStop, FOnNewBest InOnNewBest)
+{
+	OnNewBest = MoveTemp(InOnNewBest);
+	BestScore.store(-MAX_flt, std::memory_order_relaxed);
+	MigrationsSent.store(0, std::memory_order_relaxed);
+	MigrationsAdopted.store(0, std::memory_order_relaxed);
+
+	for (int32 IslandIndex = 0; IslandIndex < Islands.Num(); IslandIndex++)
+	{
+		OfferBest(IslandIndex);
+	}
+
+	// One island per body. Islands never block on each other, so the run finishes even if fewer workers than islands are free.
+	ParallelFor(Islands.Num(), [this, MaximumIterations, &ShouldStop](int32 IslandIndex)
+		{
+			RunIsland(IslandIndex, MaximumIterations, ShouldStop);
+		}, EParallelForFlags::BackgroundPriority | EParallelForFlags::Unbalanced);
+
+	// Migrants sent after the receiver finished are dropped
+	for (TUniquePtr<FIsland>& Island : Islands)
+	{
+		Island->Inbox.Empty();
+	}
+	NumMigrationsSent = MigrationsSent.load(std::memory_order_relaxed);
+	NumMigrationsAdopted = MigrationsAdopted.load(std::memory_order_relaxed);
+	OnNewBest = nullptr;
+}
+
+int32 FEvoIslandEvolution::GetBestIslandIndex() const
+{
+	check(Islands.Num() > 0);
+	int32 BestIndex = 0;
+	for (int32 IslandIndex = 1; IslandIndex < Islands.Num(); IslandIndex++)
+	{
+		if (Islands[IslandIndex]->Evolution.IncumbentFitness.Score > Islands[BestIndex]->Evolution.IncumbentFitness.Score)
+		{
+			BestIndex = IslandIndex;
+		}
+	}
+	return BestIndex;
+}
+
+int32 FEvoIslandEvolution::GetIslandSeed(int32 RunSeed, int32 IslandIndex)
+{
+	return FEvoEvolution::DeriveStreamSeed(RunSeed, 0, FEvoEvolution::StreamIslandBase + IslandIndex);
+}
+
+void FEvoIslandEvolution::RunIsland(int32 IslandIndex, int32 MaximumIterations, const TFunction<bool()>& ShouldStop)
+{
+	LLM_SCOPE_BYTAG(EvoMaps);
+	TRACE_CPUPROFILER_EVENT_SCOPE(FEvoIslandEvolution::RunIsland);
+	FEvoEvolution& Evolution = Islands[IslandIndex]->Evolution;
+	const bool bMigrate = Islands.Num() > 1 && IslandSettings.MigrationInterval > 0;
+
+	while (Evolution.IterationCounter < MaximumIterations && !(ShouldStop && ShouldStop()))
+	{
+		if (Evolution.StepIteration())
+		{
+			OfferBest(IslandIndex);
+		}
+
+		if (bMigrate && Evolution.IterationCounter % IslandSettings.MigrationInterval == 0)
+		{
+			Emigrate(IslandIndex);
+			Immigrate(IslandIndex);
+		}
+	}
+}
+
+void FEvoIslandEvolution::Emigrate(int32 IslandIndex)
+{
+	const FEvoEvolution& Evolution = Islands[IslandIndex]->Evolution;
+
+	FEvoMigrant Migrant;
+	Migrant.Graphs = Evolution.EvoGraphs;
+	Migrant.Score = Evolution.IncumbentFitness.Score;
+	Migrant.SourceIsland = IslandIndex;
+	Islands[(IslandIndex + 1) % Islands.Num()]->Inbox.Enqueue(MoveTemp(Migrant));
+	MigrationsSent.fetch_add(1, std::memory_order_relaxed);
+}
+
+void FEvoIslandEvolution::Immigrate(int32 IslandIndex)
+{
+	TRACE_CPUPROFILER_EVENT_SCOPE(FEvoIslandEvolution::Immigrate);
+	FIsland& Island = *Islands[IslandIndex];
+	FEvoEvolution& Evolution = Island.Evolution;
+
+	// Only the best of everything that arrived since the last migration is considered
+	FEvoMigrant Best;
+	FEvoMigrant Migrant;
+	bool bHasMigrant = false;
+	while (Island.Inbox.Dequeue(Migrant))
+	{
+		if (!bHasMigrant || Migrant.Score > Best.Score)
+		{
+			Best = MoveTemp(Migrant);
+			bHasMigrant = true;
+		}
+	}
+	if (!bHasMigrant)
+	{
+		return;
+	}
+
+	const bool bStagnated = IslandSettings.StagnationLimit > 0 && Evolution.IterationsSinceLastIncrease >= IslandSettings.StagnationLimit;
+	if (Best.Score <= Evolution.IncumbentFitness.Score && !bStagnated)
+	{
+		return;
+	}
+
+	// Evaluation is deterministic, the rebuilt incumbent scores exactly what the source island reported
+	Evolution.EvoGraphs = MoveTemp(Best.Graphs);
+	Evolution.RebuildIncumbent();
+	Evolution.IterationsSinceLastIncrease = 0;
+	MigrationsAdopted.fetch_add(1, std::memory_order_relaxed);
+	OfferBest(IslandIndex);
+}
+
+void FEvoIslandEvolution::OfferBest(int32 IslandIndex)
+{
+	const FEvoEvolution& Evolution = Islands[IslandIndex]->Evolution;
+	const float Score = Evolution.IncumbentFitness.Score;
+	if (Score <= BestScore.load(std::memory_order_relaxed))
+	{
+		return;
+	}
+
+	FScopeLock Lock(&BestLock);
+	if (Score <= BestScore.load(std::memory_order_relaxed))
+	{
+		return;
+	}
+	BestScore.store(Score, std::memory_order_relaxed);
+	if (OnNewBest)
+	{
+		OnNewBest(Evolution);
+	}
+}
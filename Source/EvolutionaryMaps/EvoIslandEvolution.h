@@ -0,0 +1,99 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Containers/Queue.h"
+#include "EvoStructs.h"
+#include "EvoEvolution.h"
+#include <atomic>
+
+class UEvoMapGenerator;
+
+struct FEvoIslandSettings
+{
+	// Independent populations, 1 disables the island model
+	int32 NumIslands = 1;
+
+	// Every island sends its incumbent to the next island in the ring every MigrationInterval of its own iterations, 0 disables migration
+	int32 MigrationInterval = 50;
+
+	// An island that has not improved for this many iterations takes the best immigrant even if it scores lower, 0 disables
+	int32 StagnationLimit = 200;
+};
+
+// Incumbent of an island on its way to the next one
+struct FEvoMigrant
+{
+	TArray<FEvoGraph> Graphs;
+	float Score = 0.0f;
+	int32 SourceIsland = INDEX_NONE;
+};
+
+/**
+ * Island model on top of FEvoEvolution. Every island is a full (1+lambda) run with its own seed, all islands run at once
+ * on background workers and exchange incumbents over lock-free single producer queues arranged in a ring.
+ * Islands never wait for each other, so when migrants arrive depends on scheduling and a run is only reproducible with a single island.
+ */
+class EVOLUTIONARYMAPS_API FEvoIslandEvolution
+{
+public:
+	// Called with the island that just became the global best. Calls are serialized but come from the island's worker.
+	using FOnNewBest = TFunction<void(const FEvoEvolution& /*Island*/)>;
+
+	void Initialize(UEvoMapGenerator* InMapGen, const FEvoEvolutionSettings& InSettings, const FEvoIslandSettings& InIslandSettings);
+
+	// Blocks until every island has run MaximumIterations or ShouldStop returns true. ShouldStop is polled by every island after each iteration.
+	void Run(int32 MaximumIterations, TFunction<bool()> ShouldStop, FOnNewBest OnNewBest);
+
+	int32 GetNumIslands() const
+	{
+		return Islands.Num();
+	}
+
+	FEvoEvolution& GetIsland(int32 IslandIndex)
+	{
+		return Islands[IslandIndex]->Evolution;
+	}
+
+	const FEvoEvolution& GetIsland(int32 IslandIndex) const
+	{
+		return Islands[IslandIndex]->Evolution;
+	}
+
+	// Island with the highest incumbent score, the lowest index wins ties
+	int32 GetBestIslandIndex() const;
+
+	// Seed of island IslandIndex, derived from the run seed in the setup generation
+	static int32 GetIslandSeed(int32 RunSeed, int32 IslandIndex);
+
+	// Migrants sent and adopted over the last Run
+	int32 NumMigrationsSent = 0;
+	int32 NumMigrationsAdopted = 0;
+
+private:
+	struct FIsland
+	{
+		FEvoEvolution Evolution;
+
+		// Written only by the previous island in the ring, read only by this one
+		TQueue<FEvoMigrant, EQueueMode::Spsc> Inbox;
+	};
+
+	void RunIsland(int32 IslandIndex, int32 MaximumIterations, const TFunction<bool()>& ShouldStop);
+	void Emigrate(int32 IslandIndex);
+	void Immigrate(int32 IslandIndex);
+	void OfferBest(int32 IslandIndex);
+
+	FEvoIslandSettings IslandSettings;
+	TArray<TUniquePtr<FIsland>> Islands;
+
+	FOnNewBest OnNewBest;
+
+	// Checked without the lock so islands only contend when they actually improve on the global best
+	std::atomic<float> BestScore { -MAX_flt };
+	FCriticalSection BestLock;
+
+	std::atomic<int32> MigrationsSent { 0 };
+	std::atomic<int32> MigrationsAdopted { 0 };
+};
@@ -0,0 +1,446 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "EvoMapCommandlet.h"
+#include "EvoEvolution.h"
+#include "EvoIslandEvolution.h"
+#include "EvoTelemetry.h"
+#include "EvoMapGenerator.h"
+#include "JsonObjectConverter.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+#include "Misc/CommandLine.h"
+#include "HAL/PlatformProcess.h"
+#include "Hash/CityHash.h"
+#include "UObject/StrongObjectPtr.h"
+
+DEFINE_LOG_CATEGORY_STATIC(LogEvoMapCommandlet, Log, All);
+
+// Marks the result line a worker logs per run, the coordinator parses it from the worker's stdout
+static const TCHAR* WorkerResultTag = TEXT("EVOMAP_RESULT");
+
+// One finished run, reported by a worker or by this process, and its line in Summary.csv
+struct FEvoRunSummary
+{
+	int32 Run = 0;
+	int32 Seed = 0;
+	float Score = 0.0f;
+	int32 StreetCount = 0;
+	int32 CanalCount = 0;
+	int32 OverlapTiles = 0;
+	uint64 GridHash = 0;
+};
+
+struct FEvoWorkerProcess
+{
+	FProcHandle Handle;
+	void* ReadPipe = nullptr;
+	void* WritePipe = nullptr;
+
+	// Runs handed to the process that have not been reported yet. Runs are done in order, so this is always a contiguous range.
+	TArray<int32> PendingRuns;
+
+	// Output after the last complete line
+	FString PendingOutput;
+
+	int32 Restarts = 0;
+	bool bRunning = false;
+};
+
+// Finds candidates for maps with identical tiles across runs, a match is confirmed by comparing the grid rows
+static uint64 HashGrid(const FEvoGrid& Grid)
+{
+	const uint64 SizeSeed = (static_cast<uint64>(Grid.Width) << 32) | static_cast<uint32>(Grid.Height);
+	return CityHash64WithSeed(reinterpret_cast<const char*>(Grid.TagBits.GetData()), Grid.TagBits.Num() * sizeof(uint64), SizeSeed);
+}
+
+static bool LoadGridRows(const FString& OutputDir, int32 Run, TArray<FString>& OutRows)
+{
+	FString Json;
+	FEvoMapRunResult Result;
+	const FString FilePath = OutputDir / FString::Printf(TEXT("Run_%d.json"), Run);
+	if (!FFileHelper::LoadFileToString(Json, *FilePath) || !FJsonObjectConverter::JsonObjectStringToUStruct(Json, &Result))
+	{
+		UE_LOG(LogEvoMapCommandlet, Warning, TEXT("Failed to read %s, its run is not checked for duplicates"), *FilePath);
+		return false;
+	}
+	OutRows = MoveTemp(Result.GridRows);
+	return true;
+}
+
+// Writes Summary.csv in run order. Runs that ended on the same map as an earlier run name it in the DuplicateOf column.
+static bool WriteSummary(TArray<FEvoRunSummary> Results, const FString& OutputDir, int32 NumRuns)
+{
+	Results.Sort([](const FEvoRunSummary& A, const FEvoRunSummary& B)
+		{
+			return A.Run < B.Run;
+		});
+
+	// Distinct maps by hash, more than one only on a collision. Rows are loaded from the run files when a hash repeats.
+	TMap<uint64, TArray<int32>> UniqueRunsByHash;
+	TMap<int32, TArray<FString>> LoadedRows;
+	int32 NumUnique = 0;
+	FString Summary = TEXT("Run,Seed,Score,StreetCount,CanalCount,OverlapTiles,DuplicateOf\n");
+	for (const FEvoRunSummary& Result : Results)
+	{
+		TArray<int32>& Candidates = UniqueRunsByHash.FindOrAdd(Result.GridHash);
+		int32 DuplicateOf = INDEX_NONE;
+		TArray<FString> Rows;
+		if (Candidates.Num() > 0 && LoadGridRows(OutputDir, Result.Run, Rows))
+		{
+			for (const int32 Candidate : Candidates)
+			{
+				if (!LoadedRows.Contains(Candidate) && !LoadGridRows(OutputDir, Candidate, LoadedRows.Add(Candidate)))
+				{
+					continue;
+				}
+				if (LoadedRows[Candidate] == Rows)
+				{
+					DuplicateOf = Candidate;
+					break;
+				}
+			}
+		}
+		if (DuplicateOf == INDEX_NONE)
+		{
+			Candidates.Add(Result.Run);
+			NumUnique++;
+		}
+		Summary += FString::Printf(TEXT("%d,%d,%f,%d,%d,%d,%d\n"), Result.Run, Result.Seed, Result.Score, Result.StreetCount, Result.CanalCount, Result.OverlapTiles, DuplicateOf);
+	}
+	UE_LOG(LogEvoMapCommandlet, Display, TEXT("%d of %d runs finished, %d unique maps"), Results.Num(), NumRuns, NumUnique);
+
+	const FString SummaryPath = OutputDir / TEXT("Summary.csv");
+	if (!FFileHelper::SaveStringToFile(Summary, *SummaryPath))
+	{
+		UE_LOG(LogEvoMapCommandlet, Error, TEXT("Failed to write %s"), *SummaryPath);
+		return false;
+	}
+	return true;
+}
+
+// Same project, commandlet and parameters as this process, with the coordinator switches replaced by a run range
+static FString MakeWorkerCommandLine(int32 FirstRun, int32 Runs)
+{
+	const TCHAR* const CoordinatorSwitches[] = { TEXT("-Workers="), TEXT("-MaxRestarts="), TEXT("-FirstRun="), TEXT("-Runs=") };
+
+	FString CommandLine;
+	const TCHAR* Stream = FCommandLine::Get();
+	FString Token;
+	while (FParse::Token(Stream, Token, false))
+	{
+		bool bSkip = false;
+		for (const TCHAR* Switch : CoordinatorSwitches)
+		{
+			bSkip |= Token.StartsWith(Switch, ESearchCase::IgnoreCase);
+		}
+		if (bSkip)
+		{
+			continue;
+		}
+		CommandLine += Token.Contains(TEXT(" ")) ? FString::Printf(TEXT("\"%s\" "), *Token) : Token + TEXT(" ");
+	}
+	CommandLine += FString::Printf(TEXT("-EvoWorker -FirstRun=%d -Runs=%d"), FirstRun, Runs);
+	return CommandLine;
+}
+
+static bool LaunchWorker(FEvoWorkerProcess& Worker)
+{
+	check(Worker.PendingRuns.Num() > 0);
+	FPlatformProcess::CreatePipe(Worker.ReadPipe, Worker.WritePipe);
+	const FString Arguments = MakeWorkerCommandLine(Worker.PendingRuns[0], Worker.PendingRuns.Num());
+	Worker.Handle = FPlatformProcess::CreateProc(FPlatformProcess::ExecutablePath(), *Arguments, false, true, true, nullptr, 0, nullptr, Worker.WritePipe);
+	Worker.PendingOutput.Reset();
+	Worker.bRunning = Worker.Handle.IsValid();
+	if (!Worker.bRunning)
+	{
+		FPlatformProcess::ClosePipe(Worker.ReadPipe, Worker.WritePipe);
+		UE_LOG(LogEvoMapCommandlet, Error, TEXT("Failed to launch a worker for runs %d-%d"), Worker.PendingRuns[0], Worker.PendingRuns.Last());
+	}
+	return Worker.bRunning;
+}
+
+// Collects the result lines a worker printed since the last call
+static void ReadWorkerOutput(FEvoWorkerProcess& Worker, TMap<int32, FEvoRunSummary>& Results)
+{
+	Worker.PendingOutput += FPlatformProcess::ReadPipe(Worker.ReadPipe);
+
+	int32 LineEnd = INDEX_NONE;
+	while (Worker.PendingOutput.FindChar(TEXT('\n'), LineEnd))
+	{
+		const FString Line = Worker.PendingOutput.Left(LineEnd);
+		Worker.PendingOutput.RightChopInline(LineEnd + 1, EAllowShrinking::No);
+
+		const int32 TagIndex = Line.Find(WorkerResultTag, ESearchCase::CaseSensitive);
+		if (TagIndex == INDEX_NONE)
+		{
+			continue;
+		}
+		const TCHAR* Fields = *Line + TagIndex;
+		FEvoRunSummary Result;
+		if (FParse::Value(Fields, TEXT("Run="), Result.Run) && FParse::Value(Fields, TEXT("Seed="), Result.Seed) && FParse::Value(Fields, TEXT("Score="), Result.Score)
+			&& FParse::Value(Fields, TEXT("Street="), Result.StreetCount) && FParse::Value(Fields, TEXT("Canal="), Result.CanalCount)
+			&& FParse::Value(Fields, TEXT("Overlap="), Result.OverlapTiles) && FParse::Value(Fields, TEXT("Hash="), Result.GridHash))
+		{
+			Results.Add(Result.Run, Result);
+			Worker.PendingRuns.Remove(Result.Run);
+		}
+	}
+}
+
+UEvoMapCommandlet::UEvoMapCommandlet()
+{
+	IsClient = false;
+	IsServer = false;
+	IsEditor = false;
+	LogToConsole = true;
+}
+
+int32 UEvoMapCommandlet::Main(const FString& Params)
+{
+	LLM_SCOPE_BYTAG(EvoMaps);
+	const TCHAR* Cmd = *Params;
+
+	FEvoEvolutionSettings Settings;
+	int32 Iterations = 1000;
+	int32 Seed = 0;
+	int32 Runs = 1;
+	FString OutputDir = FPaths::ProjectSavedDir() / TEXT("EvoMaps");
+
+	FParse::Value(Cmd, TEXT("Width="), Settings.Width);
+	FParse::Value(Cmd, TEXT("Height="), Settings.Height);
+	FParse::Value(Cmd, TEXT("Iterations="), Iterations);
+	FParse::Value(Cmd, TEXT("Mutations="), Settings.MutationsPerIteration);
+	FParse::Value(Cmd, TEXT("Offspring="), Settings.OffspringPerIteration);
+	FParse::Value(Cmd, TEXT("TargetStreetTiles="), Settings.EvaluationParams.TargetStreetTiles);
+	FParse::Value(Cmd, TEXT("TargetCanalTiles="), Settings.EvaluationParams.TargetCanalTiles);
+	FParse::Value(Cmd, TEXT("TargetStartStartDistance="), Settings.EvaluationParams.TargetStartStartDistance);
+	FParse::Value(Cmd, TEXT("TargetStartDestinationDistance="), Settings.EvaluationParams.TargetStartDestinationDistance);
+	FParse::Value(Cmd, TEXT("Seed="), Seed);
+	FParse::Value(Cmd, TEXT("Runs="), Runs);
+	FParse::Value(Cmd, TEXT("Output="), OutputDir);
+	Settings.bValidateIncrementalRaster = FParse::Param(Cmd, TEXT("ValidateRaster"));
+
+	int32 FirstRun = 0;
+	int32 NumWorkers = 0;
+	int32 MaxRestarts = 2;
+	FParse::Value(Cmd, TEXT("FirstRun="), FirstRun);
+	FParse::Value(Cmd, TEXT("Workers="), NumWorkers);
+	FParse::Value(Cmd, TEXT("MaxRestarts="), MaxRestarts);
+	const bool bWorker = FParse::Param(Cmd, TEXT("EvoWorker"));
+
+	FEvoIslandSettings IslandSettings;
+	FParse::Value(Cmd, TEXT("Islands="), IslandSettings.NumIslands);
+	FParse::Value(Cmd, TEXT("MigrationInterval="), IslandSettings.MigrationInterval);
+	FParse::Value(Cmd, TEXT("StagnationLimit="), IslandSettings.StagnationLimit);
+
+	FString TelemetryFormatName;
+	int32 TelemetrySampleInterval = 1;
+	FParse::Value(Cmd, TEXT("Telemetry="), TelemetryFormatName);
+	FParse::Value(Cmd, TEXT("TelemetryEvery="), TelemetrySampleInterval);
+	const bool bWriteTelemetry = !TelemetryFormatName.IsEmpty();
+	const EEvoTelemetryFormat TelemetryFormat = TelemetryFormatName.Equals(TEXT("jsonl"), ESearchCase::IgnoreCase) ? EEvoTelemetryFormat::JsonLines : EEvoTelemetryFormat::Csv;
+
+	if (Settings.Width <= 0 || Settings.Height <= 0 || Iterations < 0 || Runs <= 0 || IslandSettings.NumIslands <= 0)
+	{
+		UE_LOG(LogEvoMapCommandlet, Error, TEXT("Invalid parameters: Width=%d Height=%d Iterations=%d Runs=%d Islands=%d"), Settings.Width, Settings.Height, Iterations, Runs, IslandSettings.NumIslands);
+		return 1;
+	}
+	const bool bIslands = IslandSettings.NumIslands > 1;
+	if (bIslands && bWriteTelemetry)
+	{
+		UE_LOG(LogEvoMapCommandlet, Warning, TEXT("-Telemetry is not recorded with -Islands"));
+	}
+
+	if (NumWorkers > 0 && !bWorker)
+	{
+		return RunWorkerFarm(NumWorkers, FirstRun, Runs, MaxRestarts, OutputDir);
+	}
+
+	TStrongObjectPtr<UEvoMapGenerator> MapGen(NewObject<UEvoMapGenerator>(GetTransientPackage()));
+	FEvoEvolution SingleEvolution;
+	FEvoIslandEvolution IslandEvolution;
+	FEvoTelemetry Telemetry;
+
+	TArray<FEvoRunSummary> Summaries;
+
+	for (int32 Run = FirstRun; Run < FirstRun + Runs; Run++)
+	{
+		const int32 RunSeed = Seed + Run;
+		Settings.Seed = RunSeed;
+
+		if (bIslands)
+		{
+			IslandEvolution.Initialize(MapGen.Get(), Settings, IslandSettings);
+			IslandEvolution.Run(Iterations, nullptr, nullptr);
+			UE_LOG(LogEvoMapCommandlet, Display, TEXT("Run %d: %d islands, %d migrants sent, %d adopted"), Run, IslandEvolution.GetNumIslands(), IslandEvolution.NumMigrationsSent, IslandEvolution.NumMigrationsAdopted);
+		}
+		else
+		{
+			SingleEvolution.Initialize(MapGen.Get(), Settings);
+			SingleEvolution.ResetToVeniceStart();
+			if (bWriteTelemetry)
+			{
+				Telemetry.Open(OutputDir / FString::Printf(TEXT("Run_%d_Telemetry"), Run), TelemetryFormat, TelemetrySampleInterval);
+			}
+			for (int32 i = 0; i < Iterations; i++)
+			{
+				const bool bAccepted = SingleEvolution.StepIteration();
+				Telemetry.RecordIteration(SingleEvolution, bAccepted);
+			}
+			Telemetry.Close();
+		}
+		const FEvoEvolution& Evolution = bIslands ? IslandEvolution.GetIsland(IslandEvolution.GetBestIslandIndex()) : SingleEvolution;
+
+		FEvoMapRunResult Result;
+		Result.Seed = RunSeed;
+		Result.Iterations = Evolution.IterationCounter;
+		Result.Fitness = Evolution.IncumbentFitness;
+		Result.Graphs = Evolution.EvoGraphs;
+		Result.GridRows = GridToRows(Evolution.IncumbentGrid);
+
+		FString Json;
+		const FString FilePath = OutputDir / FString::Printf(TEXT("Run_%d.json"), Run);
+		if (!FJsonObjectConverter::UStructToJsonObjectString(Result, Json) || !FFileHelper::SaveStringToFile(Json, *FilePath))
+		{
+			UE_LOG(LogEvoMapCommandlet, Error, TEXT("Failed to write %s"), *FilePath);
+			return 1;
+		}
+
+		const FEvoFitness& Fitness = Evolution.IncumbentFitness;
+		FEvoRunSummary& RunSummary = Summaries.AddDefaulted_GetRef();
+		RunSummary.Run = Run;
+		RunSummary.Seed = RunSeed;
+		RunSummary.Score = Fitness.Score;
+		RunSummary.StreetCount = Fitness.StreetCount;
+		RunSummary.CanalCount = Fitness.CanalCount;
+		RunSummary.OverlapTiles = Fitness.OverlapTiles;
+		RunSummary.GridHash = HashGrid(Evolution.IncumbentGrid);
+		UE_LOG(LogEvoMapCommandlet, Display, TEXT("Run %d/%d (Seed %d): Value %f after %d Iterations"), Run + 1, FirstRun + Runs, RunSeed, Fitness.Score, Evolution.IterationCounter);
+		if (bWorker)
+		{
+			UE_LOG(LogEvoMapCommandlet, Display, TEXT("%s Run=%d Seed=%d Score=%f Street=%d Canal=%d Overlap=%d Hash=%llu"), WorkerResultTag,
+				Run, RunSeed, Fitness.Score, Fitness.StreetCount, Fitness.CanalCount, Fitness.OverlapTiles, RunSummary.GridHash);
+		}
+	}
+
+	// The coordinator writes the summary of all workers
+	if (bWorker)
+	{
+		return 0;
+	}
+	return WriteSummary(MoveTemp(Summaries), OutputDir, Runs) ? 0 : 1;
+}
+
+int32 UEvoMapCommandlet::RunWorkerFarm(int32 NumWorkers, int32 FirstRun, int32 Runs, int32 MaxRestarts, const FString& OutputDir)
+{
+	// Every worker gets a contiguous range of runs and therefore seeds
+	NumWorkers = FMath::Min(NumWorkers, Runs);
+	TArray<FEvoWorkerProcess> Workers;
+	Workers.SetNum(NumWorkers);
+	bool bFailed = false;
+	for (int32 WorkerIndex = 0; WorkerIndex < NumWorkers; WorkerIndex++)
+	{
+		FEvoWorkerProcess& Worker = Workers[WorkerIndex];
+		for (int32 Run = FirstRun + Runs * WorkerIndex / NumWorkers; Run < FirstRun + Runs * (WorkerIndex + 1) / NumWorkers; Run++)
+		{
+			Worker.PendingRuns.Add(Run);
+		}
+		bFailed |= !LaunchWorker(Worker);
+	}
+	UE_LOG(LogEvoMapCommandlet, Display, TEXT("Started %d workers for runs %d-%d"), NumWorkers, FirstRun, FirstRun + Runs - 1);
+
+	TMap<int32, FEvoRunSummary> Results;
+	bool bAnyRunning = true;
+	while (bAnyRunning)
+	{
+		FPlatformProcess::Sleep(0.1f);
+		bAnyRunning = false;
+		for (FEvoWorkerProcess& Worker : Workers)
+		{
+			if (!Worker.bRunning)
+			{
+				continue;
+			}
+			ReadWorkerOutput(Worker, Results);
+			if (FPlatformProcess::IsProcRunning(Worker.Handle))
+			{
+				bAnyRunning = true;
+				continue;
+			}
+
+			// Lines written right before the exit
+			ReadWorkerOutput(Worker, Results);
+			int32 ReturnCode = 0;
+			FPlatformProcess::GetProcReturnCode(Worker.Handle, &ReturnCode);
+			FPlatformProcess::CloseProc(Worker.Handle);
+			FPlatformProcess::ClosePipe(Worker.ReadPipe, Worker.WritePipe);
+			Worker.bRunning = false;
+
+			if (Worker.PendingRuns.Num() == 0)
+			{
+				continue;
+			}
+
+			// Crashed or failed, the runs it already reported are kept and the rest is handed to a new process
+			if (Worker.Restarts >= MaxRestarts)
+			{
+				UE_LOG(LogEvoMapCommandlet, Error, TEXT("Worker for runs %d-%d exited with code %d, giving up after %d restarts"), Worker.PendingRuns[0], Worker.PendingRuns.Last(), ReturnCode, Worker.Restarts);
+				bFailed = true;
+				continue;
+			}
+			Worker.Restarts++;
+			UE_LOG(LogEvoMapCommandlet, Warning, TEXT("Worker for runs %d-%d exited with code %d, restarting (%d/%d)"), Worker.PendingRuns[0], Worker.PendingRuns.Last(), ReturnCode, Worker.Restarts, MaxRestarts);
+			bFailed |= !LaunchWorker(Worker);
+			bAnyRunning |= Worker.bRunning;
+		}
+	}
+
+	TArray<FEvoRunSummary> Summaries;
+	Results.GenerateValueArray(Summaries);
+	if (!WriteSummary(MoveTemp(Summaries), OutputDir, Runs))
+	{
+		return 1;
+	}
+	return (bFailed || Results.Num() != Runs) ? 1 : 0;
+}
+
+TArray<FString> UEvoMapCommandlet::GridToRows(const FEvoGrid& Grid)
+{
+	TArray<FString> Rows;
+	Rows.Reserve(Grid.Height);
+	for (int32 Y = 0; Y < Grid.Height; Y++)
+	{
+		FString& Row = Rows.AddDefaulted_GetRef();
+		Row.Reserve(Grid.Width);
+		for (int32 X = 0; X < Grid.Width; X++)
+		{
+			const bool bStreet = Grid.HasTag(X, Y, EEvoTileTag::Street);
+			const bool bCanal = Grid.HasTag(X, Y, EEvoTileTag::Canal);
+
+			TCHAR Symbol = TEXT('.');
+			if (Grid.HasTag(X, Y, EEvoTileTag::Destination))
+			{
+				Symbol = TEXT('D');
+			}
+			else if (Grid.HasTag(X, Y, EEvoTileTag::PlayerStart))
+			{
+				Symbol = TEXT('P');
+			}
+			else if (bStreet && bCanal)
+			{
+				Symbol = TEXT('B');
+			}
+			else if (bStreet)
+			{
+				Symbol = TEXT('S');
+			}
+			else if (bCanal)
+			{
+				Symbol = TEXT('C');
+			}
+			Row.AppendChar(Symbol);
+		}
+	}
+	return Rows;
+}
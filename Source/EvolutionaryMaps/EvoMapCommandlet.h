@@ -0,0 +1,65 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Commandlets/Commandlet.h"
+#include "EvoStructs.h"
+#include "EvoMapCommandlet.generated.h"
+
+// Everything one headless run writes to disk
+USTRUCT()
+struct FEvoMapRunResult
+{
+	GENERATED_BODY()
+
+public:
+	UPROPERTY()
+	int32 Seed = 0;
+
+	UPROPERTY()
+	int32 Iterations = 0;
+
+	UPROPERTY()
+	FEvoFitness Fitness;
+
+	UPROPERTY()
+	TArray<FEvoGraph> Graphs;
+
+	// One string per grid row, see UEvoMapCommandlet::GridToRows for the legend
+	UPROPERTY()
+	TArray<FString> GridRows;
+};
+
+/**
+ * Runs the evolution without a world, for batch map generation on build agents.
+ *
+ * UnrealEditor-Cmd EvolutionaryMaps.uproject -run=EvoMap -nullrhi -Width=64 -Height=64 -Iterations=1000 -Mutations=20
+ *     -Offspring=1 -TargetStreetTiles=800 -TargetCanalTiles=400 -TargetStartStartDistance=40 -TargetStartDestinationDistance=60
+ *     -Seed=0 -Runs=1 -Output=<Dir> [-Telemetry=csv|jsonl -TelemetryEvery=1] [-ValidateRaster]
+ *     [-Islands=1 -MigrationInterval=50 -StagnationLimit=200] [-Workers=0 -MaxRestarts=2]
+ *
+ * Run i uses seed Seed + i and writes Run_<i>.json to the output directory (default Saved/EvoMaps), plus one Summary.csv line.
+ * With -Telemetry every sampled iteration is streamed to Run_<i>_Telemetry.csv or .jsonl.
+ * With -Islands=N > 1 each run evolves N migrating populations and writes the best one, Iterations then counts per island.
+ * With -Workers=N the runs are split into N contiguous seed ranges, each run by a child process of the same commandlet.
+ * Children report every run on stdout and a child that exits early is restarted on its remaining runs up to MaxRestarts times.
+ * In both modes Summary.csv marks runs whose map is identical to an earlier run in the DuplicateOf column, -1 otherwise.
+ * Candidates are found by a 64 bit grid hash and confirmed by comparing the GridRows of their run files.
+ */
+UCLASS()
+class EVOLUTIONARYMAPS_API UEvoMapCommandlet : public UCommandlet
+{
+	GENERATED_BODY()
+
+public:
+	UEvoMapCommandlet();
+
+	virtual int32 Main(const FString& Params) override;
+
+	// Coordinator of -Workers, returns the exit code of the commandlet
+	static int32 RunWorkerFarm(int32 NumWorkers, int32 FirstRun, int32 Runs, int32 MaxRestarts, const FString& OutputDir);
+
+	// '.' empty, 'S' street, 'C' canal, 'B' street over canal, 'P' player start, 'D' destination
+	static TArray<FString> GridToRows(const FEvoGrid& Grid);
+};
@@ -2,6 +2,12 @@
 
 
 #include "EvoMapGenerator.h"
+#include "EvoStats.h"
+#include "EvoMemory.h"
+#include "Engine/TextureRenderTarget2D.h"
+#include "RenderingThread.h"
+#include "RHICommandList.h"
+#include "TextureResource.h"
 
 
 FEvoGraph UEvoMapGenerator::InitGraph(int Width, int Height, EEvoTileTag Tag)
@@ -12,7 +18,7 @@ FEvoGraph UEvoMapGenerator::InitGraph(int Width, int Height, EEvoTileTag Tag)
 	return Graph;
 }
 
-FEvoGraph UEvoMapGenerator::AddNodes(FEvoGraph Graph, int Count, TArray<EEvoTileTag> Tags, bool bCanBeDeleted, bool bStaticLocation)
+FEvoGraph UEvoMapGenerator::AddNodes(FEvoGraph Graph, int Count, TArray<EEvoTileTag> Tags, bool bCanBeDeleted, bool bStaticLocation, FRandomStream& RandomStream)
 {
 	for (int i = 0; i < Count; i++)
 	{
@@ -20,30 +26,62 @@ FEvoGraph UEvoMapGenerator::AddNodes(FEvoGraph Graph, int Count, TArray<EEvoTile
 		NewNode.AdditonalTags = Tags;
 		NewNode.CanBeDeleted = bCanBeDeleted;
 		NewNode.StaticLocation = bStaticLocation;
-		Graph.AddNodeAtRandomLocation(NewNode);
+		Graph.AddNodeAtRandomLocation(NewNode, RandomStream);
 	}
 	return Graph;
 }
 
-FEvoGraph UEvoMapGenerator::AddEdges(FEvoGraph Graph, int Count)
+FEvoGraph UEvoMapGenerator::AddEdges(FEvoGraph Graph, int Count, FRandomStream& RandomStream)
 {
 	for (int i = 0; i < Count; i++)
 	{
-		Graph.AddRandomEdge();
+		Graph.AddRandomEdge(RandomStream);
 	}
 
 	return Graph;
 }
 
+TArray<FEvoGraph> UEvoMapGenerator::InitVeniceGraphs(int Width, int Height, FRandomStream& RandomStream)
+{
+	LLM_SCOPE_BYTAG(EvoMaps);
+	TArray<FEvoGraph> Graphs;
+
+	FEvoGraph StreetGraph;
+	StreetGraph = InitGraph(Width, Height, EEvoTileTag::Street);
+	StreetGraph = AddNodes(StreetGraph, 4, { EEvoTileTag::PlayerStart }, false, false, RandomStream);
+	StreetGraph = AddNodes(StreetGraph, 1, { EEvoTileTag::Destination }, false, false, RandomStream);
+	StreetGraph = AddNodes(StreetGraph, 10, {}, true, false, RandomStream);
+	StreetGraph = AddEdges(StreetGraph, 10, RandomStream);
+	Graphs.Add(StreetGraph);
+
+	FEvoGraph CanalGraph;
+	CanalGraph = InitGraph(Width, Height, EEvoTileTag::Canal);
+	CanalGraph = AddNodes(CanalGraph, 10, {}, true, false, RandomStream);
+	CanalGraph = AddEdges(CanalGraph, 10, RandomStream);
+	Graphs.Add(CanalGraph);
+
+	return Graphs;
+}
+
 FEvoGrid UEvoMapGenerator::GenerateGridFromGraphs(const TArray<FEvoGraph>& Graphs)
 {
+	FEvoGrid Grid;
+	GenerateGridFromGraphsInto(Graphs, Grid);
+	return Grid;
+}
+
+void UEvoMapGenerator::GenerateGridFromGraphsInto(const TArray<FEvoGraph>& InGraphs, FEvoGrid& Grid)
+{
+	LLM_SCOPE_BYTAG(EvoMaps);
+	SCOPE_CYCLE_COUNTER(STAT_EvoGenerateGrid);
+	TArray<FEvoGraph> IndexedCopy;
+	const TArray<FEvoGraph>& Graphs = FEvoGraph::GetIndexed(InGraphs, IndexedCopy);
 	if (Graphs.Num() == 0)
 	{
-		FEvoGrid EmptyGrid;
-		return EmptyGrid;
+		Grid = FEvoGrid();
+		return;
 	}
 
-	FEvoGrid Grid;
 	Grid.Initialize(Graphs[0].GridSize.X, Graphs[0].GridSize.Y);
 
 	for (const FEvoGraph& Graph : Graphs)
@@ -59,8 +97,8 @@ FEvoGrid UEvoMapGenerator::GenerateGridFromGraphs(const TArray<FEvoGraph>& Graph
 
 		for (const FEvoEdge& Edge : Graph.Edges)
 		{
-			FIntPoint Start = Edge.StartNodeLocation;
-			FIntPoint End = Edge.EndNodeLocation;
+			FIntPoint Start = Graph.GetNodeLocation(Edge.StartNodeId);
+			FIntPoint End = Graph.GetNodeLocation(Edge.EndNodeId);
 			Start.X = FMath::Clamp(Start.X, 0, Grid.Width - 1);
 			Start.Y = FMath::Clamp(Start.Y, 0, Grid.Height - 1);
 			End.X = FMath::Clamp(End.X, 0, Grid.Width - 1);
@@ -71,10 +109,7 @@ FEvoGrid UEvoMapGenerator::GenerateGridFromGraphs(const TArray<FEvoGraph>& Graph
 				// Draw horizontal segment
 				int32 MinX = FMath::Min(Start.X, End.X);
 				int32 MaxX = FMath::Max(Start.X, End.X);
-				for (int32 X = MinX; X <= MaxX; ++X)
-				{
-					Grid.AddTileTag(X, Start.Y, Graph.PrimaryTileTag);
-				}
+				Grid.AddTileTagSpan(MinX, MaxX, Start.Y, Graph.PrimaryTileTag);
 				// Draw vertical segment.
 				int32 MinY = FMath::Min(Start.Y, End.Y);
 				int32 MaxY = FMath::Max(Start.Y, End.Y);
@@ -95,147 +130,206 @@ FEvoGrid UEvoMapGenerator::GenerateGridFromGraphs(const TArray<FEvoGraph>& Graph
 				// Draw horizontal segment
 				int32 MinX = FMath::Min(Start.X, End.X);
 				int32 MaxX = FMath::Max(Start.X, End.X);
-				for (int32 X = MinX; X <= MaxX; ++X)
-				{
-					Grid.AddTileTag(X, End.Y, Graph.PrimaryTileTag);
-				}
+				Grid.AddTileTagSpan(MinX, MaxX, End.Y, Graph.PrimaryTileTag);
 			}
 		}
 	}
-
-	return Grid;
 }
 
 
-TArray<FEvoGraph> UEvoMapGenerator::MutateGraphArray(const TArray<FEvoGraph>& Graphs, int32 NumberOfMutations)
+void UEvoMapGenerator::MutateGraphArray(TArray<FEvoGraph>& Graphs, int32 NumberOfMutations, FRandomStream& RandomStream, FEvoMutationLog* OutLog)
 {
-	TArray<FEvoGraph> MutatedGraphs = Graphs;
-
-	if (MutatedGraphs.Num() == 0)
+	LLM_SCOPE_BYTAG(EvoMaps);
+	SCOPE_CYCLE_COUNTER(STAT_EvoMutate);
+	if (Graphs.Num() == 0)
 	{
-		return MutatedGraphs;
+		return;
 	}
 	for (int32 i = 0; i < NumberOfMutations; i++)
 	{
 		// Pick a random graph
-		int32 RandomIndex = FMath::RandRange(0, MutatedGraphs.Num() - 1);
-		FEvoGraph SelectedGraph = MutatedGraphs[RandomIndex];
+		int32 RandomIndex = RandomStream.RandRange(0, Graphs.Num() - 1);
+		FEvoGraph& SelectedGraph = Graphs[RandomIndex];
+		const int32 FirstChange = OutLog ? OutLog->GraphChanges.Num() : 0;
 
 		// Pick a random mutation type
-		int32 MutationType = FMath::RandRange(1, 6);
+		int32 MutationType = RandomStream.RandRange(1, 6);
 		switch (MutationType)
 		{
 		case 1: // Remove a node (and connected edges)
-			SelectedGraph.RemoveRandomNode();
+			SelectedGraph.RemoveRandomNode(RandomStream, OutLog);
 			break;
 		case 2: // Add a new node
 		{
 			FEvoNode NewNode;
 			NewNode.CanBeDeleted = true;
 			NewNode.StaticLocation = false;
-			SelectedGraph.AddNodeAtRandomLocation(NewNode);
+			SelectedGraph.AddNodeAtRandomLocation(NewNode, RandomStream, OutLog);
 		}
 		break;
 		case 3: // Move a node (update its location and connected edges)
-			SelectedGraph.MoveNode();
+			SelectedGraph.MoveNode(RandomStream, OutLog);
 			break;
 		case 4: // Remove an edge
-			SelectedGraph.RemoveRandomEdge();
+			SelectedGraph.RemoveRandomEdge(RandomStream, OutLog);
 			break;
 		case 5: // Add an edge
-			SelectedGraph.AddRandomEdge();
+			SelectedGraph.AddRandomEdge(RandomStream, OutLog);
 			break;
 		case 6: // Change an edge's mode
-			SelectedGraph.ChangeEdgeMode();
+			SelectedGraph.ChangeEdgeMode(RandomStream, OutLog);
 			break;
 		default:
 			break;
 		}
 
-		// Replace the graph at RandomIndex with the mutated version
-		MutatedGraphs[RandomIndex] = SelectedGraph;
+		if (OutLog)
+		{
+			for (int32 ChangeIndex = FirstChange; ChangeIndex < OutLog->GraphChanges.Num(); ChangeIndex++)
+			{
+				OutLog->GraphChanges[ChangeIndex].GraphIndex = RandomIndex;
+			}
+		}
 	}
-
-	return MutatedGraphs;
 }
 
 
-void UEvoMapGenerator::DrawGridToRenderTarget(UObject* WorldContext, FEvoGrid Grid, UTextureRenderTarget2D* RenderTarget)
+// Index into the tile palette of DrawGridToRenderTarget, markers are drawn over streets and streets over canals
+static int32 GetTileColorIndex(const FEvoGrid& Grid, int32 X, int32 Y)
 {
-	if (!RenderTarget) return;
-
-	// Clear the render target with a specific color
-	if (true)
+	if (Grid.HasTag(X, Y, EEvoTileTag::Destination))
 	{
-		UKismetRenderingLibrary::ClearRenderTarget2D(WorldContext, RenderTarget, FLinearColor::Black);
+		return 4;
 	}
+	if (Grid.HasTag(X, Y, EEvoTileTag::PlayerStart))
+	{
+		return 3;
+	}
+	if (Grid.HasTag(X, Y, EEvoTileTag::Street))
+	{
+		return 1;
+	}
+	if (Grid.HasTag(X, Y, EEvoTileTag::Canal))
+	{
+		return 2;
+	}
+	return 0;
+}
 
-	// Begin a render target drawing session
-	FTextureRenderTargetResource* RenderTargetResource = RenderTarget->GameThread_GetRenderTargetResource();
-	FCanvas Canvas(RenderTargetResource, nullptr, 0, 0, 0, WorldContext->GetWorld()->GetFeatureLevel());
+// Writes Color in the memory layout of Format, returns the number of bytes per pixel or 0 if the format is not supported
+static int32 EncodePixel(EPixelFormat Format, const FLinearColor& Color, uint8* OutPixel)
+{
+	switch (Format)
+	{
+	case PF_B8G8R8A8:
+	{
+		const FColor Encoded = Color.ToFColor(true);
+		OutPixel[0] = Encoded.B;
+		OutPixel[1] = Encoded.G;
+		OutPixel[2] = Encoded.R;
+		OutPixel[3] = Encoded.A;
+		return 4;
+	}
+	case PF_R8G8B8A8:
+	{
+		const FColor Encoded = Color.ToFColor(true);
+		OutPixel[0] = Encoded.R;
+		OutPixel[1] = Encoded.G;
+		OutPixel[2] = Encoded.B;
+		OutPixel[3] = Encoded.A;
+		return 4;
+	}
+	case PF_FloatRGBA:
+	{
+		const FFloat16Color Encoded(Color);
+		FMemory::Memcpy(OutPixel, &Encoded, sizeof(FFloat16Color));
+		return sizeof(FFloat16Color);
+	}
+	case PF_A32B32G32R32F:
+	{
+		FMemory::Memcpy(OutPixel, &Color, sizeof(FLinearColor));
+		return sizeof(FLinearColor);
+	}
+	default:
+		return 0;
+	}
+}
 
+void UEvoMapGenerator::DrawGridToRenderTarget(UObject* WorldContext, const FEvoGrid& Grid, UTextureRenderTarget2D* RenderTarget, FIntRect DirtyRect)
+{
+	LLM_SCOPE_BYTAG(EvoMaps);
+	SCOPE_CYCLE_COUNTER(STAT_EvoDrawGrid);
+	if (!RenderTarget) return;
 
-	// Convert normalized positions to pixel positions and draw 1x1 squares
-	int32 RT_Width = Grid.Width;
-	int32 RT_Height = Grid.Height;
-	FLinearColor PixelColor = FLinearColor::White;
+	FTextureRenderTargetResource* RenderTargetResource = RenderTarget->GameThread_GetRenderTargetResource();
+	if (!RenderTargetResource) return;
 
-	for (int32 Y = 0; Y < RT_Height; Y++)
+	// Palette in the target's pixel format: empty, street, canal, player start, destination
+	const EPixelFormat Format = RenderTarget->GetFormat();
+	const FLinearColor Colors[] = { FLinearColor::Black, FLinearColor(0.2f, 0.2f, 0.2f, 1.0f), FLinearColor::Blue, FLinearColor::Green, FLinearColor::Red };
+	constexpr int32 NumColors = UE_ARRAY_COUNT(Colors);
+	uint8 Palette[NumColors][sizeof(FLinearColor)];
+	int32 BytesPerPixel = 0;
+	for (int32 i = 0; i < NumColors; i++)
 	{
-		for (int32 X = 0; X < RT_Width; X++)
-		{
-			// Calculate the index for the current tile
-			int32 Index = Y * RT_Width + X;
+		BytesPerPixel = EncodePixel(Format, Colors[i], Palette[i]);
+	}
+	if (BytesPerPixel == 0)
+	{
+		UE_LOG(LogTemp, Warning, TEXT("DrawGridToRenderTarget: unsupported render target pixel format %d"), static_cast<int32>(Format));
+		return;
+	}
 
-			//if (!Grid.IsValidIndex(Index))
-			//{
-			//	continue; // Skip invalid indices (just in case)
-			//}
+	const bool bFullRedraw = DirtyRect.Area() <= 0;
+	if (bFullRedraw)
+	{
+		DirtyRect = FIntRect(0, 0, Grid.Width, Grid.Height);
 
-			// Get the current tile
-			const FEvoTile& Tile = Grid.GetTile(X, Y);
+		// Pixels outside the grid are never uploaded, so clear them once
+		if (RenderTarget->SizeX != Grid.Width || RenderTarget->SizeY != Grid.Height)
+		{
+			UKismetRenderingLibrary::ClearRenderTarget2D(WorldContext, RenderTarget, FLinearColor::Black);
+		}
+	}
+	DirtyRect.Clip(FIntRect(0, 0, FMath::Min(Grid.Width, static_cast<int32>(RenderTarget->SizeX)), FMath::Min(Grid.Height, static_cast<int32>(RenderTarget->SizeY))));
+	if (DirtyRect.Area() <= 0) return;
 
-			if (Tile.Tags.Contains(EEvoTileTag::Street))
-			{
-				// Determine Pixel Position
-				FVector2D PixelPosition(X, Y);
-				FVector2D PixelSize(1.0f, 1.0f);
-				PixelColor = FLinearColor(0.2f, 0.2f, 0.2f, 1.0f);
-				// Draw the pixel as a 1x1 tile
-				FCanvasTileItem TileItem(PixelPosition, PixelSize, PixelColor);
-				TileItem.BlendMode = SE_BLEND_Opaque;
-				Canvas.DrawItem(TileItem);
-			}
-			else if (Tile.Tags.Contains(EEvoTileTag::Canal))
-			{
-				FVector2D PixelPosition(X, Y);
-				FVector2D PixelSize(1.0f, 1.0f);
-				PixelColor = FLinearColor::Blue;
-				FCanvasTileItem TileItem(PixelPosition, PixelSize, PixelColor);
-				TileItem.BlendMode = SE_BLEND_Opaque;
-				Canvas.DrawItem(TileItem);
-			}
+	const int32 RegionWidth = DirtyRect.Width();
+	const int32 RegionHeight = DirtyRect.Height();
+	const uint32 Pitch = RegionWidth * BytesPerPixel;
 
-			if (Tile.Tags.Contains(EEvoTileTag::PlayerStart))
+	TArray<uint8> Pixels;
+	Pixels.SetNumUninitialized(Pitch * RegionHeight);
+	uint8* Pixel = Pixels.GetData();
+	for (int32 Y = DirtyRect.Min.Y; Y < DirtyRect.Max.Y; Y++)
+	{
+		for (int32 X = DirtyRect.Min.X; X < DirtyRect.Max.X;)
+		{
+			// Runs inside empty summary blocks are filled without looking at the tiles
+			const int32 Word = X / FEvoGrid::BitsPerWord;
+			const int32 RunEnd = FMath::Min((Word + 1) * FEvoGrid::BitsPerWord, DirtyRect.Max.X);
+			if (Grid.IsBlockEmpty(Word, Y))
 			{
-				FVector2D PixelPosition(X, Y);
-				FVector2D PixelSize(1.0f, 1.0f);
-				PixelColor = FLinearColor::Green;
-				FCanvasTileItem TileItem(PixelPosition, PixelSize, PixelColor);
-				TileItem.BlendMode = SE_BLEND_Opaque;
-				Canvas.DrawItem(TileItem);
+				for (; X < RunEnd; X++)
+				{
+					FMemory::Memcpy(Pixel, Palette[0], BytesPerPixel);
+					Pixel += BytesPerPixel;
+				}
+				continue;
 			}
-			if (Tile.Tags.Contains(EEvoTileTag::Destination))
+			for (; X < RunEnd; X++)
 			{
-				FVector2D PixelPosition(X, Y);
-				FVector2D PixelSize(1.0f, 1.0f);
-				PixelColor = FLinearColor::Red;
-				FCanvasTileItem TileItem(PixelPosition, PixelSize, PixelColor);
-				TileItem.BlendMode = SE_BLEND_Opaque;
-				Canvas.DrawItem(TileItem);
+				FMemory::Memcpy(Pixel, Palette[GetTileColorIndex(Grid, X, Y)], BytesPerPixel);
+				Pixel += BytesPerPixel;
 			}
 		}
 	}
-	// End the canvas drawing session
-	Canvas.Flush_GameThread();
-}
\ No newline at end of file
+
+	// Single region update on the render thread, the pixel buffer moves into the command
+	const FUpdateTextureRegion2D Region(DirtyRect.Min.X, DirtyRect.Min.Y, 0, 0, RegionWidth, RegionHeight);
+	ENQUEUE_RENDER_COMMAND(EvoDrawGridToRenderTarget)(
+		[RenderTargetResource, Region, Pitch, Pixels = MoveTemp(Pixels)](FRHICommandListImmediate& RHICmdList)
+		{
+			RHICmdList.UpdateTexture2D(RenderTargetResource->GetRenderTargetTexture(), 0, Region, Pitch, Pixels.GetData());
+		});
+}
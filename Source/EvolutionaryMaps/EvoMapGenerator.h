@@ -5,8 +5,6 @@
 #include "CoreMinimal.h"
 #include "UObject/NoExportTypes.h"
 #include "EvoStructs.h"
-#include "CanvasItem.h"
-#include "CanvasTypes.h"
 #include "Kismet/KismetRenderingLibrary.h"
 #include "EvoMapGenerator.generated.h"
 
@@ -21,15 +19,25 @@ class EVOLUTIONARYMAPS_API UEvoMapGenerator : public UObject
 public:
 
 	FEvoGraph InitGraph(int Width, int Height, EEvoTileTag Tag);
-	FEvoGraph AddNodes(FEvoGraph Graph, int Count, TArray<EEvoTileTag> Tags, bool bCanBeDeleted, bool bStaticLocation);
-	FEvoGraph AddEdges(FEvoGraph Graph, int Count);
+	FEvoGraph AddNodes(FEvoGraph Graph, int Count, TArray<EEvoTileTag> Tags, bool bCanBeDeleted, bool bStaticLocation, FRandomStream& RandomStream);
+	FEvoGraph AddEdges(FEvoGraph Graph, int Count, FRandomStream& RandomStream);
 
-	TArray<FEvoGraph> MutateGraphArray(const TArray<FEvoGraph>& Graphs, int32 NumberOfMutations);
+	// Street graph with 4 PlayerStarts, a Destination and free nodes, plus a Canal graph
+	TArray<FEvoGraph> InitVeniceGraphs(int Width, int Height, FRandomStream& RandomStream);
+
+	// Mutates Graphs in place. OutLog receives every graph change, to undo or replay the candidate, and the raster changes for FEvoIncrementalRasterizer.
+	// Touches no state besides Graphs and the stream, so offspring with their own copies and streams can be mutated on worker threads.
+	void MutateGraphArray(TArray<FEvoGraph>& Graphs, int32 NumberOfMutations, FRandomStream& RandomStream, FEvoMutationLog* OutLog = nullptr);
 
 
 	FEvoGrid GenerateGridFromGraphs(const TArray<FEvoGraph>& Graphs);
 
+	// Rasterizes into an existing grid so its bit rows are reused instead of reallocated
+	void GenerateGridFromGraphsInto(const TArray<FEvoGraph>& Graphs, FEvoGrid& Grid);
+
 
-	void DrawGridToRenderTarget(UObject* WorldContext, FEvoGrid Grid, UTextureRenderTarget2D* RenderTarget);
+	// Builds one pixel buffer for the grid and uploads it in a single texture region update.
+	// An empty DirtyRect redraws the whole grid, otherwise only the tiles inside it are uploaded.
+	void DrawGridToRenderTarget(UObject* WorldContext, const FEvoGrid& Grid, UTextureRenderTarget2D* RenderTarget, FIntRect DirtyRect = FIntRect());
 	
 };
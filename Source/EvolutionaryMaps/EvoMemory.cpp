@@ -0,0 +1,70 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "EvoMemory.h"
+#include "EvoVenice.h"
+#include "AssetSpawnerVenice.h"
+#include "EvoDistanceEngine.h"
+#include "EngineUtils.h"
+#include "HAL/IConsoleManager.h"
+
+LLM_DEFINE_TAG(EvoMaps);
+
+FEvoMemoryFootprint& FEvoMemoryFootprint::operator+=(const FEvoMemoryFootprint& InOther)
+{
+	Graphs += InOther.Graphs;
+	Grids += InOther.Grids;
+	AssetMaps += InOther.AssetMaps;
+	BfsScratch += InOther.BfsScratch;
+	SpawnerInstances += InOther.SpawnerInstances;
+	Other += InOther.Other;
+	return *this;
+}
+
+void FEvoMemoryFootprint::Dump(FOutputDevice& Ar, const TCHAR* Label) const
+{
+	Ar.Logf(TEXT("%s: %.1f KiB"), Label, GetTotal() / 1024.0);
+	Ar.Logf(TEXT("    Graphs            %10.1f KiB"), Graphs / 1024.0);
+	Ar.Logf(TEXT("    Grids             %10.1f KiB"), Grids / 1024.0);
+	Ar.Logf(TEXT("    Asset maps        %10.1f KiB"), AssetMaps / 1024.0);
+	Ar.Logf(TEXT("    BFS scratch       %10.1f KiB"), BfsScratch / 1024.0);
+	Ar.Logf(TEXT("    Spawner instances %10.1f KiB"), SpawnerInstances / 1024.0);
+	Ar.Logf(TEXT("    Other             %10.1f KiB"), Other / 1024.0);
+}
+
+static void DumpEvoMapsMemory(const TArray<FString>& Args, UWorld* World, FOutputDevice& Ar)
+{
+	if (!World)
+	{
+		return;
+	}
+
+	FEvoMemoryFootprint Total;
+	for (TActorIterator<AEvoVenice> It(World); It; ++It)
+	{
+		FEvoMemoryFootprint Footprint;
+		It->GetMemoryFootprint(Footprint);
+		Footprint.Dump(Ar, *It->GetName());
+		Total += Footprint;
+	}
+	for (TActorIterator<AAssetSpawnerVenice> It(World); It; ++It)
+	{
+		FEvoMemoryFootprint Footprint;
+		It->GetMemoryFootprint(Footprint);
+		Footprint.Dump(Ar, *It->GetName());
+		Total += Footprint;
+	}
+
+	// Shared by everything that evaluates maps, so only counted once
+	FEvoMemoryFootprint Scratch;
+	Scratch.BfsScratch = FEvoDistanceEngine::GetTotalAllocatedSize();
+	Scratch.Dump(Ar, TEXT("Distance engines"));
+	Total += Scratch;
+
+	Total.Dump(Ar, TEXT("EvoMaps total"));
+}
+
+static FAutoConsoleCommandWithWorldArgsAndOutputDevice GEvoMapsDumpMemoryCommand(
+	TEXT("EvoMaps.DumpMemory"),
+	TEXT("Logs the heap bytes held by the evo actors of the world by category: graphs, grids, asset maps, BFS scratch and spawner instances"),
+	FConsoleCommandWithWorldArgsAndOutputDeviceDelegate::CreateStatic(&DumpEvoMapsMemory));
@@ -0,0 +1,44 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "HAL/LowLevelMemTracker.h"
+
+// Every allocation of the generator, spawner and evolution runs. Entry points and worker bodies open an LLM_SCOPE_BYTAG(EvoMaps).
+LLM_DECLARE_TAG_API(EvoMaps, EVOLUTIONARYMAPS_API);
+
+/**
+ * Heap bytes held by evo data, by category. Filled by the GetMemoryFootprint functions and dumped by the
+ * EvoMaps.DumpMemory console command.
+ */
+struct EVOLUTIONARYMAPS_API FEvoMemoryFootprint
+{
+	// FEvoGraph arrays, including offspring copies and snapshots
+	SIZE_T Graphs = 0;
+
+	// FEvoGrid and rasterizer coverage
+	SIZE_T Grids = 0;
+
+	// FEvoAssetMap
+	SIZE_T AssetMaps = 0;
+
+	// FEvoDistanceEngine buffers of every thread
+	SIZE_T BfsScratch = 0;
+
+	// Instance bookkeeping of the spawner and the instance data of its components
+	SIZE_T SpawnerInstances = 0;
+
+	// Mutation logs, fitness distance arrays and other per-run scratch
+	SIZE_T Other = 0;
+
+	SIZE_T GetTotal() const
+	{
+		return Graphs + Grids + AssetMaps + BfsScratch + SpawnerInstances + Other;
+	}
+
+	FEvoMemoryFootprint& operator+=(const FEvoMemoryFootprint& InOther);
+
+	// One line per category in KiB
+	void Dump(FOutputDevice& Ar, const TCHAR* Label) const;
+};
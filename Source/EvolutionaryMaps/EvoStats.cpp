@@ -0,0 +1,30 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "EvoStats.h"
+
+DEFINE_STAT(STAT_EvoStepIteration);
+DEFINE_STAT(STAT_EvoMutate);
+DEFINE_STAT(STAT_EvoIncrementalRaster);
+DEFINE_STAT(STAT_EvoGenerateGrid);
+DEFINE_STAT(STAT_EvoEvaluate);
+DEFINE_STAT(STAT_EvoStreetBfs);
+DEFINE_STAT(STAT_EvoDrawGrid);
+DEFINE_STAT(STAT_EvoTranslateMap);
+DEFINE_STAT(STAT_EvoSpawnMap);
+DEFINE_STAT(STAT_EvoApplyChunks);
+
+DEFINE_STAT(STAT_EvoIterationsPerSecond);
+DEFINE_STAT(STAT_EvoAcceptanceRate);
+DEFINE_STAT(STAT_EvoFitness);
+
+DEFINE_STAT(STAT_EvoBfsNodesExpanded);
+DEFINE_STAT(STAT_EvoInstancesSpawned);
+
+TRACE_DECLARE_FLOAT_COUNTER(EvoMaps_IterationsPerSecond, TEXT("EvoMaps/IterationsPerSecond"));
+TRACE_DECLARE_FLOAT_COUNTER(EvoMaps_AcceptanceRate, TEXT("EvoMaps/AcceptanceRate"));
+TRACE_DECLARE_FLOAT_COUNTER(EvoMaps_Fitness, TEXT("EvoMaps/Fitness"));
+TRACE_DECLARE_INT_COUNTER(EvoMaps_BfsNodesExpanded, TEXT("EvoMaps/BfsNodesExpanded"));
+TRACE_DECLARE_INT_COUNTER(EvoMaps_InstancesSpawned, TEXT("EvoMaps/InstancesSpawned"));
+
+std::atomic<int64> GEvoBfsNodesExpanded { 0 };
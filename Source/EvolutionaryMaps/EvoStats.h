@@ -0,0 +1,46 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Stats/Stats.h"
+#include "ProfilingDebugging/CpuProfilerTrace.h"
+#include "ProfilingDebugging/CountersTrace.h"
+#include <atomic>
+
+/**
+ * Stats and trace counters of the generation pipeline, shown by "stat EvoMaps" and in Unreal Insights.
+ * Pipeline stages use cycle stats, which also emit CPU trace scopes. Helpers inside a stage only use
+ * TRACE_CPUPROFILER_EVENT_SCOPE, so they show up in Insights without cluttering the stat group.
+ */
+DECLARE_STATS_GROUP(TEXT("EvoMaps"), STATGROUP_EvoMaps, STATCAT_Advanced);
+
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Step Iteration"), STAT_EvoStepIteration, STATGROUP_EvoMaps, EVOLUTIONARYMAPS_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Mutate"), STAT_EvoMutate, STATGROUP_EvoMaps, EVOLUTIONARYMAPS_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Incremental Raster"), STAT_EvoIncrementalRaster, STATGROUP_EvoMaps, EVOLUTIONARYMAPS_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Generate Grid"), STAT_EvoGenerateGrid, STATGROUP_EvoMaps, EVOLUTIONARYMAPS_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Evaluate"), STAT_EvoEvaluate, STATGROUP_EvoMaps, EVOLUTIONARYMAPS_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Street BFS"), STAT_EvoStreetBfs, STATGROUP_EvoMaps, EVOLUTIONARYMAPS_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Draw Grid"), STAT_EvoDrawGrid, STATGROUP_EvoMaps, EVOLUTIONARYMAPS_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Translate Map"), STAT_EvoTranslateMap, STATGROUP_EvoMaps, EVOLUTIONARYMAPS_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Spawn Map"), STAT_EvoSpawnMap, STATGROUP_EvoMaps, EVOLUTIONARYMAPS_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Apply Chunks"), STAT_EvoApplyChunks, STATGROUP_EvoMaps, EVOLUTIONARYMAPS_API);
+
+// Set by FEvoEvolution about four times per second and kept between updates, the last run to report wins if several run at once
+DECLARE_FLOAT_ACCUMULATOR_STAT_EXTERN(TEXT("Iterations Per Second"), STAT_EvoIterationsPerSecond, STATGROUP_EvoMaps, EVOLUTIONARYMAPS_API);
+DECLARE_FLOAT_ACCUMULATOR_STAT_EXTERN(TEXT("Acceptance Rate"), STAT_EvoAcceptanceRate, STATGROUP_EvoMaps, EVOLUTIONARYMAPS_API);
+DECLARE_FLOAT_ACCUMULATOR_STAT_EXTERN(TEXT("Fitness"), STAT_EvoFitness, STATGROUP_EvoMaps, EVOLUTIONARYMAPS_API);
+
+// Per frame
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("BFS Nodes Expanded"), STAT_EvoBfsNodesExpanded, STATGROUP_EvoMaps, EVOLUTIONARYMAPS_API);
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Instances Spawned"), STAT_EvoInstancesSpawned, STATGROUP_EvoMaps, EVOLUTIONARYMAPS_API);
+
+// Insights timelines of the same values, the node and instance counters are running totals
+TRACE_DECLARE_FLOAT_COUNTER_EXTERN(EvoMaps_IterationsPerSecond);
+TRACE_DECLARE_FLOAT_COUNTER_EXTERN(EvoMaps_AcceptanceRate);
+TRACE_DECLARE_FLOAT_COUNTER_EXTERN(EvoMaps_Fitness);
+TRACE_DECLARE_INT_COUNTER_EXTERN(EvoMaps_BfsNodesExpanded);
+TRACE_DECLARE_INT_COUNTER_EXTERN(EvoMaps_InstancesSpawned);
+
+// Running total behind EvoMaps_BfsNodesExpanded. Searches on any thread add to it, FEvoEvolution publishes it with the other counters.
+extern EVOLUTIONARYMAPS_API std::atomic<int64> GEvoBfsNodesExpanded;
@@ -6,6 +6,18 @@
 #include "UObject/NoExportTypes.h"
 #include "EvoStructs.generated.h"
 
+// Heap bytes of an array plus everything its elements own, for element types with GetAllocatedSize
+template <typename ElementType, typename AllocatorType>
+SIZE_T EvoGetDeepAllocatedSize(const TArray<ElementType, AllocatorType>& Array)
+{
+	SIZE_T Size = Array.GetAllocatedSize();
+	for (const ElementType& Element : Array)
+	{
+		Size += Element.GetAllocatedSize();
+	}
+	return Size;
+}
+
 UENUM(BlueprintType)
 enum class EEvoTileTag : uint8
 {
@@ -49,6 +61,13 @@ enum class EEvoInstructionTag : uint8
 	BridgeEastWest
 };
 
+UENUM(BlueprintType)
+enum class EEvoTelemetryFormat : uint8
+{
+	Csv UMETA(DisplayName = "CSV"),
+	JsonLines UMETA(DisplayName = "JSON Lines")
+};
+
 
 // =================================================== Graph Layer ===================================================
 
@@ -69,6 +88,19 @@ public:
 
 	UPROPERTY(EditAnywhere, BlueprintReadWrite)
 	bool StaticLocation;
+
+	// Stable while the node exists, assigned by its FEvoGraph. Index into FEvoGraph::NodeSlots.
+	UPROPERTY()
+	int32 Id = INDEX_NONE;
+
+	// Indices into FEvoGraph::Edges of every edge touching this node, maintained by the graph
+	TArray<int32, TInlineAllocator<4>> EdgeIndices;
+
+	// Heap bytes only, EdgeIndices counts once it outgrows its inline storage
+	SIZE_T GetAllocatedSize() const
+	{
+		return AdditonalTags.GetAllocatedSize() + EdgeIndices.GetAllocatedSize();
+	}
 };
 
 USTRUCT(BlueprintType)
@@ -77,16 +109,169 @@ struct FEvoEdge
 	GENERATED_BODY()
 
 public:
+	// FEvoNode::Id of the endpoints
+	UPROPERTY()
+	int32 StartNodeId = INDEX_NONE;
+
+	UPROPERTY()
+	int32 EndNodeId = INDEX_NONE;
+
 	UPROPERTY()
-	FIntPoint StartNodeLocation;
+	EEvoEdgeType Type = EEvoEdgeType::HorizontalFirst;
 
+	// Deprecated, endpoints of edges saved before edges referred to node ids. Only read by FEvoGraph::RebuildIndex,
+	// which resolves an edge without either id to the nodes at these locations. New edges leave them unset.
 	UPROPERTY()
-	FIntPoint EndNodeLocation;
+	FIntPoint StartNodeLocation = FIntPoint::ZeroValue;
 
 	UPROPERTY()
-	EEvoEdgeType Type;
+	FIntPoint EndNodeLocation = FIntPoint::ZeroValue;
+};
+
+// Refers to a node across mutations. Resolves to nothing once the node was removed, even if its id was reused.
+struct FEvoNodeHandle
+{
+	int32 Id = INDEX_NONE;
+	uint32 Generation = 0;
+
+	bool IsSet() const
+	{
+		return Id != INDEX_NONE;
+	}
+};
+
+// Dense position of the node with this id, and how often the id was freed
+struct FEvoNodeSlot
+{
+	int32 NodeIndex = INDEX_NONE;
+	uint32 Generation = 0;
+};
+
+/**
+ * One primitive change to what a graph rasterizes, emitted by the FEvoGraph mutators.
+ * A node delta covers its location with every tag in TagMask, an edge delta covers its L shaped path with its graph's PrimaryTileTag.
+ */
+struct FEvoRasterDelta
+{
+	bool bAdd = true;
+	bool bIsEdge = false;
+
+	// Bit per EEvoTileTag
+	uint8 TagMask = 0;
+
+	FIntPoint Start = FIntPoint::ZeroValue;
+	FIntPoint End = FIntPoint::ZeroValue;
+	EEvoEdgeType EdgeType = EEvoEdgeType::HorizontalFirst;
+
+	static FEvoRasterDelta ForNode(const FEvoNode& Node, bool bAdd)
+	{
+		FEvoRasterDelta Delta;
+		Delta.bAdd = bAdd;
+		Delta.Start = Node.Location;
+		Delta.End = Node.Location;
+		for (const EEvoTileTag Tag : Node.AdditonalTags)
+		{
+			Delta.TagMask |= 1 << static_cast<uint8>(Tag);
+		}
+		return Delta;
+	}
+
+	static FEvoRasterDelta ForEdge(FIntPoint Start, FIntPoint End, EEvoEdgeType Type, EEvoTileTag PrimaryTileTag, bool bAdd)
+	{
+		FEvoRasterDelta Delta;
+		Delta.bAdd = bAdd;
+		Delta.bIsEdge = true;
+		Delta.TagMask = 1 << static_cast<uint8>(PrimaryTileTag);
+		Delta.Start = Start;
+		Delta.End = End;
+		Delta.EdgeType = Type;
+		return Delta;
+	}
+};
+
+enum class EEvoGraphChangeType : uint8
+{
+	AddNode,
+	RemoveNode,
+	MoveNode,
+	AddEdge,
+	RemoveEdge,
+	SetEdge
+};
+
+/**
+ * One primitive edit of an FEvoGraph with enough state to replay it forwards or backwards.
+ * Index is the node or edge index at the time of the edit, so a log only replays onto the graph state it was recorded on.
+ */
+struct FEvoGraphChange
+{
+	EEvoGraphChangeType Type = EEvoGraphChangeType::AddNode;
+
+	// AddNode took a new slot instead of reusing a freed id
+	bool bNewNodeSlot = false;
+
+	// Index into the mutated graph array, filled in by UEvoMapGenerator::MutateGraphArray
+	int32 GraphIndex = INDEX_NONE;
+
+	int32 Index = INDEX_NONE;
+
+	// AddNode, RemoveNode. Recorded without edges, incident edges are logged as separate changes.
+	FEvoNode Node;
+
+	// MoveNode
+	FIntPoint OldLocation = FIntPoint::ZeroValue;
+	FIntPoint NewLocation = FIntPoint::ZeroValue;
+
+	// AddEdge and RemoveEdge use NewEdge, SetEdge uses both
+	FEvoEdge OldEdge;
+	FEvoEdge NewEdge;
+
+	SIZE_T GetAllocatedSize() const
+	{
+		return Node.GetAllocatedSize();
+	}
 };
 
+struct FEvoGraph;
+
+// Everything one candidate changed: raster deltas for FEvoIncrementalRasterizer and graph changes to undo or replay the candidate in place
+struct FEvoMutationLog
+{
+	TArray<FEvoRasterDelta> RasterDeltas;
+	TArray<FEvoGraphChange> GraphChanges;
+
+	void Reset()
+	{
+		RasterDeltas.Reset();
+		GraphChanges.Reset();
+	}
+
+	SIZE_T GetAllocatedSize() const
+	{
+		return RasterDeltas.GetAllocatedSize() + EvoGetDeepAllocatedSize(GraphChanges);
+	}
+
+	// Whether a PlayerStart or Destination node was added, removed or moved, i.e. the key points have to be gathered again
+	bool TouchesKeyNodes() const
+	{
+		constexpr uint8 KeyTagMask = (1 << static_cast<uint8>(EEvoTileTag::PlayerStart)) | (1 << static_cast<uint8>(EEvoTileTag::Destination));
+		return RasterDeltas.ContainsByPredicate([](const FEvoRasterDelta& Delta)
+			{
+				return !Delta.bIsEdge && (Delta.TagMask & KeyTagMask) != 0;
+			});
+	}
+
+	// Rolls Graphs back to the state the log was recorded on
+	void Undo(TArray<FEvoGraph>& Graphs) const;
+
+	// Repeats the recorded changes on a copy of the state the log was recorded on
+	void Replay(TArray<FEvoGraph>& Graphs) const;
+};
+
+/**
+ * Nodes and Edges are dense arrays, removal swaps the last element into the gap.
+ * Nodes are referred to by stable ids, edges by index. Every node lists its edges, so moving a node or removing it costs O(degree).
+ */
 USTRUCT(BlueprintType)
 struct FEvoGraph
 {
@@ -105,137 +290,713 @@ public:
 	UPROPERTY()
 	TArray<FEvoEdge> Edges;
 
-	void AddNodeAtRandomLocation(FEvoNode NewNode)
+	// Lookup structures derived from Nodes and Edges, kept in sync by every mutator and by ApplyChange/RevertChange.
+	// Not serialized. The mutators build it on first use, const readers go through GetIndexed. Call RebuildIndex after editing Nodes or Edges directly.
+
+	// Id to dense node index. Freed ids are reused last in, first out.
+	TArray<FEvoNodeSlot> NodeSlots;
+	TArray<int32> FreeNodeIds;
+
+	// Bit per cell (Y * GridSize.X + X) that holds a node. The mutators keep at most one node per cell.
+	TArray<uint64> NodeOccupancy;
+
+	// Undirected (start id, end id, type) keys of all edges, see MakeEdgeKey
+	TSet<uint64> EdgeKeys;
+
+	bool bIndexBuilt = false;
+
+	// Nodes and edges plus the lookup structures
+	SIZE_T GetAllocatedSize() const
 	{
-		int LocX = FMath::RandRange(0, GridSize.X - 1);
-		int LocY = FMath::RandRange(0, GridSize.Y - 1);
-		NewNode.Location = FIntPoint(LocX, LocY);
-		Nodes.Add(NewNode);
+		return EvoGetDeepAllocatedSize(Nodes) + Edges.GetAllocatedSize() + NodeSlots.GetAllocatedSize() + FreeNodeIds.GetAllocatedSize()
+			+ NodeOccupancy.GetAllocatedSize() + EdgeKeys.GetAllocatedSize();
 	}
 
-	void AddRandomEdge()
+	// Random probes before MoveNode and AddNodeAtRandomLocation fall back to scanning NodeOccupancy for a free cell
+	static constexpr int32 MaxFreeCellProbes = 16;
+
+	void RebuildIndex()
 	{
-		if (Nodes.Num() < 2) return;
+		// Edges saved before they referred to node ids have neither id, they are resolved by location once the ids are final
+		TBitArray<> LegacyEdges(false, Edges.Num());
+		bool bAnyLegacyEdges = false;
+		for (int32 EdgeIndex = 0; EdgeIndex < Edges.Num(); EdgeIndex++)
+		{
+			if (Edges[EdgeIndex].StartNodeId == INDEX_NONE && Edges[EdgeIndex].EndNodeId == INDEX_NONE)
+			{
+				LegacyEdges[EdgeIndex] = true;
+				bAnyLegacyEdges = true;
+			}
+		}
 
-		int32 IndexA = FMath::RandRange(0, Nodes.Num() - 1);
-		int32 IndexB = FMath::RandRange(0, Nodes.Num() - 1);
+		// Ids are kept if they are unique and not negative, so logs and handles taken before a rebuild stay meaningful
+		int32 MaxId = INDEX_NONE;
+		TMap<int32, int32> IdCounts;
+		bool bIdsValid = true;
+		for (const FEvoNode& Node : Nodes)
+		{
+			IdCounts.FindOrAdd(Node.Id)++;
+			bIdsValid &= Node.Id >= 0;
+			MaxId = FMath::Max(MaxId, Node.Id);
+		}
+		bIdsValid &= IdCounts.Num() == Nodes.Num();
+		if (!bIdsValid)
+		{
+			// Ids are reassigned densely. Edges follow a node whose old id was valid and unique, other endpoints are ambiguous and dropped below.
+			TMap<int32, int32> NewIds;
+			MaxId = Nodes.Num() - 1;
+			for (int32 NodeIndex = 0; NodeIndex < Nodes.Num(); NodeIndex++)
+			{
+				const int32 OldId = Nodes[NodeIndex].Id;
+				if (OldId >= 0 && IdCounts.FindChecked(OldId) == 1)
+				{
+					NewIds.Add(OldId, NodeIndex);
+				}
+				Nodes[NodeIndex].Id = NodeIndex;
+			}
+			for (FEvoEdge& Edge : Edges)
+			{
+				const int32* NewStartId = NewIds.Find(Edge.StartNodeId);
+				const int32* NewEndId = NewIds.Find(Edge.EndNodeId);
+				Edge.StartNodeId = NewStartId ? *NewStartId : INDEX_NONE;
+				Edge.EndNodeId = NewEndId ? *NewEndId : INDEX_NONE;
+			}
+		}
 
-		if (IndexA == IndexB) return; // Ensure different nodes
+		if (bAnyLegacyEdges)
+		{
+			TMap<FIntPoint, int32> IdsByLocation;
+			for (const FEvoNode& Node : Nodes)
+			{
+				IdsByLocation.FindOrAdd(Node.Location, Node.Id);
+			}
+			for (TConstSetBitIterator<> It(LegacyEdges); It; ++It)
+			{
+				FEvoEdge& Edge = Edges[It.GetIndex()];
+				const int32* StartId = IdsByLocation.Find(Edge.StartNodeLocation);
+				const int32* EndId = IdsByLocation.Find(Edge.EndNodeLocation);
+				Edge.StartNodeId = StartId ? *StartId : INDEX_NONE;
+				Edge.EndNodeId = EndId ? *EndId : INDEX_NONE;
+			}
+		}
 
-		FIntPoint StartLocation = Nodes[IndexA].Location;
-		FIntPoint EndLocation = Nodes[IndexB].Location;
+		NodeSlots.Reset();
+		NodeSlots.SetNum(MaxId + 1);
+		for (int32 NodeIndex = 0; NodeIndex < Nodes.Num(); NodeIndex++)
+		{
+			NodeSlots[Nodes[NodeIndex].Id].NodeIndex = NodeIndex;
+			Nodes[NodeIndex].EdgeIndices.Reset();
+		}
+		FreeNodeIds.Reset();
+		for (int32 Id = MaxId; Id >= 0; Id--)
+		{
+			if (NodeSlots[Id].NodeIndex == INDEX_NONE)
+			{
+				FreeNodeIds.Add(Id);
+			}
+		}
 
-		EEvoEdgeType RandomEdgeType = static_cast<EEvoEdgeType>(FMath::RandRange(0, 1));
+		const int32 NumCells = FMath::Max(0, GridSize.X * GridSize.Y);
+		NodeOccupancy.Reset();
+		NodeOccupancy.SetNumZeroed((NumCells + 63) / 64);
+		for (const FEvoNode& Node : Nodes)
+		{
+			if (Node.Location.X >= 0 && Node.Location.X < GridSize.X && Node.Location.Y >= 0 && Node.Location.Y < GridSize.Y)
+			{
+				SetCellOccupied(Node.Location, true);
+			}
+		}
 
-		// Check if edge already exists
-		bool bEdgeExists = Edges.ContainsByPredicate([StartLocation, EndLocation, RandomEdgeType](const FEvoEdge& Edge)
+		// Graphs from Blueprint or loaded data may have edges to nodes that do not exist
+		const int32 NumEdgesBefore = Edges.Num();
+		Edges.RemoveAll([this](const FEvoEdge& Edge)
 			{
-				return (Edge.StartNodeLocation == StartLocation && Edge.EndNodeLocation == EndLocation && Edge.Type == RandomEdgeType) ||
-					(Edge.StartNodeLocation == EndLocation && Edge.EndNodeLocation == StartLocation && Edge.Type == RandomEdgeType);
+				return !IsLiveNodeId(Edge.StartNodeId) || !IsLiveNodeId(Edge.EndNodeId);
 			});
+		if (Edges.Num() != NumEdgesBefore)
+		{
+			UE_LOG(LogTemp, Warning, TEXT("FEvoGraph::RebuildIndex: dropped %d edges with missing end nodes"), NumEdgesBefore - Edges.Num());
+		}
 
-		if (!bEdgeExists)
+		EdgeKeys.Reset();
+		for (int32 EdgeIndex = 0; EdgeIndex < Edges.Num(); EdgeIndex++)
 		{
-			FEvoEdge NewEdge;
-			NewEdge.StartNodeLocation = StartLocation;
-			NewEdge.EndNodeLocation = EndLocation;
-			NewEdge.Type = RandomEdgeType;
-			Edges.Add(NewEdge);
+			const FEvoEdge& Edge = Edges[EdgeIndex];
+			EdgeKeys.Add(MakeEdgeKey(Edge));
+			GetNodeById(Edge.StartNodeId).EdgeIndices.Add(EdgeIndex);
+			GetNodeById(Edge.EndNodeId).EdgeIndices.Add(EdgeIndex);
 		}
+
+		bIndexBuilt = true;
+	}
+
+	// Whether Id names a node, only valid while the index is in sync
+	bool IsLiveNodeId(int32 Id) const
+	{
+		return NodeSlots.IsValidIndex(Id) && NodeSlots[Id].NodeIndex != INDEX_NONE;
+	}
+
+	void EnsureIndex()
+	{
+		if (!bIndexBuilt)
+		{
+			RebuildIndex();
+		}
+	}
+
+	FEvoNode& GetNodeById(int32 Id)
+	{
+		return Nodes[NodeSlots[Id].NodeIndex];
+	}
+
+	const FEvoNode& GetNodeById(int32 Id) const
+	{
+		return Nodes[NodeSlots[Id].NodeIndex];
 	}
 
+	FIntPoint GetNodeLocation(int32 Id) const
+	{
+		check(bIndexBuilt);
+		return GetNodeById(Id).Location;
+	}
 
-	void RemoveRandomEdge()
+	// Graphs, or an indexed copy in IndexedCopy if one of them has no index yet, e.g. right after loading from UPROPERTY data
+	static const TArray<FEvoGraph>& GetIndexed(const TArray<FEvoGraph>& Graphs, TArray<FEvoGraph>& IndexedCopy)
+	{
+		if (!Graphs.ContainsByPredicate([](const FEvoGraph& Graph) { return !Graph.bIndexBuilt; }))
+		{
+			return Graphs;
+		}
+		IndexedCopy = Graphs;
+		for (FEvoGraph& Graph : IndexedCopy)
+		{
+			Graph.EnsureIndex();
+		}
+		return IndexedCopy;
+	}
+
+	FEvoNodeHandle GetHandle(int32 NodeIndex) const
+	{
+		FEvoNodeHandle Handle;
+		Handle.Id = Nodes[NodeIndex].Id;
+		Handle.Generation = NodeSlots[Handle.Id].Generation;
+		return Handle;
+	}
+
+	// Nullptr if the node was removed since the handle was taken
+	const FEvoNode* Resolve(FEvoNodeHandle Handle) const
+	{
+		if (!NodeSlots.IsValidIndex(Handle.Id) || NodeSlots[Handle.Id].Generation != Handle.Generation || NodeSlots[Handle.Id].NodeIndex == INDEX_NONE)
+		{
+			return nullptr;
+		}
+		return &Nodes[NodeSlots[Handle.Id].NodeIndex];
+	}
+
+	bool IsCellOccupied(FIntPoint Cell) const
+	{
+		const int32 CellIndex = Cell.Y * GridSize.X + Cell.X;
+		return (NodeOccupancy[CellIndex >> 6] >> (CellIndex & 63)) & 1;
+	}
+
+	// Same key for both directions of an edge
+	static uint64 MakeEdgeKey(int32 StartNodeId, int32 EndNodeId, EEvoEdgeType Type)
+	{
+		const uint32 StartId = static_cast<uint32>(StartNodeId);
+		const uint32 EndId = static_cast<uint32>(EndNodeId);
+		return (static_cast<uint64>(FMath::Min(StartId, EndId)) << 33) | (static_cast<uint64>(FMath::Max(StartId, EndId)) << 1) | static_cast<uint64>(Type);
+	}
+
+	static uint64 MakeEdgeKey(const FEvoEdge& Edge)
+	{
+		return MakeEdgeKey(Edge.StartNodeId, Edge.EndNodeId, Edge.Type);
+	}
+
+	FEvoRasterDelta MakeEdgeDelta(const FEvoEdge& Edge, bool bAdd) const
+	{
+		return FEvoRasterDelta::ForEdge(GetNodeLocation(Edge.StartNodeId), GetNodeLocation(Edge.EndNodeId), Edge.Type, PrimaryTileTag, bAdd);
+	}
+
+	// A few random probes, then a scan from a random cell, so this always terminates and only fails on a full grid
+	bool FindFreeCell(FRandomStream& RandomStream, FIntPoint& OutCell) const
+	{
+		const int32 NumCells = GridSize.X * GridSize.Y;
+		if (NumCells <= 0)
+		{
+			return false;
+		}
+		for (int32 Probe = 0; Probe < MaxFreeCellProbes; Probe++)
+		{
+			const FIntPoint Cell(RandomStream.RandRange(0, GridSize.X - 1), RandomStream.RandRange(0, GridSize.Y - 1));
+			if (!IsCellOccupied(Cell))
+			{
+				OutCell = Cell;
+				return true;
+			}
+		}
+
+		const int32 NumWords = NodeOccupancy.Num();
+		const int32 StartWord = RandomStream.RandRange(0, NumWords - 1);
+		for (int32 i = 0; i < NumWords; i++)
+		{
+			const int32 WordIndex = (StartWord + i) % NumWords;
+			uint64 FreeBits = ~NodeOccupancy[WordIndex];
+			if (WordIndex == NumWords - 1 && (NumCells & 63) != 0)
+			{
+				FreeBits &= (1ull << (NumCells & 63)) - 1;
+			}
+			if (FreeBits != 0)
+			{
+				const int32 CellIndex = WordIndex * 64 + static_cast<int32>(FMath::CountTrailingZeros64(FreeBits));
+				OutCell = FIntPoint(CellIndex % GridSize.X, CellIndex / GridSize.X);
+				return true;
+			}
+		}
+		return false;
+	}
+
+	// Every mutator draws from the given stream only, so a graph mutated with the same seed always ends up the same.
+	// The graph is changed in place, every primitive edit and the raster changes it causes are appended to OutLog if given.
+
+	// Only places the node on a free cell, nothing is added if the grid is full
+	void AddNodeAtRandomLocation(FEvoNode NewNode, FRandomStream& RandomStream, FEvoMutationLog* OutLog = nullptr)
+	{
+		EnsureIndex();
+		if (!FindFreeCell(RandomStream, NewNode.Location))
+		{
+			return;
+		}
+		NewNode.EdgeIndices.Reset();
+		bool bNewSlot = false;
+		const int32 NewIndex = InsertNode(NewNode, bNewSlot);
+
+		if (OutLog)
+		{
+			FEvoGraphChange& Change = OutLog->GraphChanges.AddDefaulted_GetRef();
+			Change.Type = EEvoGraphChangeType::AddNode;
+			Change.bNewNodeSlot = bNewSlot;
+			Change.Index = NewIndex;
+			Change.Node = Nodes[NewIndex];
+			if (Change.Node.AdditonalTags.Num() > 0)
+			{
+				OutLog->RasterDeltas.Add(FEvoRasterDelta::ForNode(Change.Node, true));
+			}
+		}
+	}
+
+	void AddRandomEdge(FRandomStream& RandomStream, FEvoMutationLog* OutLog = nullptr)
+	{
+		if (Nodes.Num() < 2) return;
+		EnsureIndex();
+
+		int32 IndexA = RandomStream.RandRange(0, Nodes.Num() - 1);
+		int32 IndexB = RandomStream.RandRange(0, Nodes.Num() - 1);
+
+		if (IndexA == IndexB) return; // Ensure different nodes
+
+		FEvoEdge NewEdge;
+		NewEdge.StartNodeId = Nodes[IndexA].Id;
+		NewEdge.EndNodeId = Nodes[IndexB].Id;
+		NewEdge.Type = static_cast<EEvoEdgeType>(RandomStream.RandRange(0, 1));
+
+		// Check if edge already exists, in either direction
+		if (EdgeKeys.Contains(MakeEdgeKey(NewEdge)))
+		{
+			return;
+		}
+
+		const int32 NewIndex = InsertEdge(NewEdge);
+		if (OutLog)
+		{
+			LogEdgeChange(*OutLog, EEvoGraphChangeType::AddEdge, NewIndex, NewEdge, NewEdge);
+		}
+	}
+
+
+	void RemoveRandomEdge(FRandomStream& RandomStream, FEvoMutationLog* OutLog = nullptr)
 	{
 		if (Edges.Num() == 0)
 		{
 			return;
 		}
-		int32 RandomIndex = FMath::RandRange(0, Edges.Num() - 1);
-		Edges.RemoveAt(RandomIndex);
+		EnsureIndex();
+		int32 RandomIndex = RandomStream.RandRange(0, Edges.Num() - 1);
+		if (OutLog)
+		{
+			LogEdgeChange(*OutLog, EEvoGraphChangeType::RemoveEdge, RandomIndex, Edges[RandomIndex], Edges[RandomIndex]);
+		}
+		RemoveEdgeAt(RandomIndex);
 	}
 
-	void RemoveRandomNode()
+	void RemoveRandomNode(FRandomStream& RandomStream, FEvoMutationLog* OutLog = nullptr)
 	{
 		if (Nodes.Num() == 0)
 		{
 			return;
 		}
 
-		int32 RandomIndex = FMath::RandRange(0, Nodes.Num() - 1);
+		int32 RandomIndex = RandomStream.RandRange(0, Nodes.Num() - 1);
 		if (Nodes[RandomIndex].CanBeDeleted == false)
 		{
 			return;
 		}
-		FIntPoint NodeLocation = Nodes[RandomIndex].Location;
+		EnsureIndex();
 
-		Edges.RemoveAll([NodeLocation](const FEvoEdge& Edge)
+		// Highest index first, so no incident edge is swapped into a gap before its own removal.
+		// The order is independent of the adjacency order, which differs between copies after undo and replay.
+		TArray<int32, TInlineAllocator<16>> IncidentEdges(Nodes[RandomIndex].EdgeIndices);
+		IncidentEdges.Sort(TGreater<int32>());
+		for (const int32 EdgeIndex : IncidentEdges)
+		{
+			if (OutLog)
 			{
-				return (Edge.StartNodeLocation == NodeLocation || Edge.EndNodeLocation == NodeLocation);
-			});
+				LogEdgeChange(*OutLog, EEvoGraphChangeType::RemoveEdge, EdgeIndex, Edges[EdgeIndex], Edges[EdgeIndex]);
+			}
+			RemoveEdgeAt(EdgeIndex);
+		}
 
-		Nodes.RemoveAt(RandomIndex);
+		if (OutLog)
+		{
+			FEvoGraphChange& Change = OutLog->GraphChanges.AddDefaulted_GetRef();
+			Change.Type = EEvoGraphChangeType::RemoveNode;
+			Change.Index = RandomIndex;
+			Change.Node = Nodes[RandomIndex];
+			if (Change.Node.AdditonalTags.Num() > 0)
+			{
+				OutLog->RasterDeltas.Add(FEvoRasterDelta::ForNode(Change.Node, false));
+			}
+		}
+		RemoveNodeAt(RandomIndex);
 	}
 
-	void MoveNode()
+	void MoveNode(FRandomStream& RandomStream, FEvoMutationLog* OutLog = nullptr)
 	{
 		if (Nodes.Num() == 0)
 		{
 			return;
 		}
 
-		int32 RandomIndex = FMath::RandRange(0, Nodes.Num() - 1);
+		EnsureIndex();
+		int32 RandomIndex = RandomStream.RandRange(0, Nodes.Num() - 1);
 		FEvoNode& SelectedNode = Nodes[RandomIndex];
 		FIntPoint OldLocation = SelectedNode.Location;
 
 		FIntPoint NewLocation = FIntPoint(0,0);
-		bool bLocationOccupied;
-
-		do
+		if (!FindFreeCell(RandomStream, NewLocation))
 		{
-			NewLocation.X = FMath::RandRange(0, GridSize.X - 1);
-			NewLocation.Y = FMath::RandRange(0, GridSize.Y - 1);
-
-			bLocationOccupied = Nodes.ContainsByPredicate([NewLocation](const FEvoNode& Node)
-				{
-					return Node.Location == NewLocation;
-				});
+			return; // Grid is full
+		}
 
-		} while (bLocationOccupied);
+		// Edges refer to the node by id and need no update, only their raster changes
+		if (OutLog)
+		{
+			AddMoveDeltas(*OutLog, SelectedNode, false);
+		}
 
 		// Update the node's location
-		SelectedNode.Location = NewLocation;
+		SetNodeLocation(RandomIndex, NewLocation);
 
-		// ?? Update all edges referencing the old location
-		for (FEvoEdge& Edge : Edges)
+		if (OutLog)
 		{
-			if (Edge.StartNodeLocation == OldLocation)
-			{
-				Edge.StartNodeLocation = NewLocation;
-			}
-			if (Edge.EndNodeLocation == OldLocation)
-			{
-				Edge.EndNodeLocation = NewLocation;
-			}
+			AddMoveDeltas(*OutLog, SelectedNode, true);
+
+			FEvoGraphChange& Change = OutLog->GraphChanges.AddDefaulted_GetRef();
+			Change.Type = EEvoGraphChangeType::MoveNode;
+			Change.Index = RandomIndex;
+			Change.OldLocation = OldLocation;
+			Change.NewLocation = NewLocation;
 		}
 	}
 
-	void ChangeEdgeMode()
+	void ChangeEdgeMode(FRandomStream& RandomStream, FEvoMutationLog* OutLog = nullptr)
 	{
 		if (Edges.Num() == 0)
 		{
 			return; // No edges to modify
 		}
 
-		int32 RandomIndex = FMath::RandRange(0, Edges.Num() - 1);
+		EnsureIndex();
+		int32 RandomIndex = RandomStream.RandRange(0, Edges.Num() - 1);
+		const FEvoEdge OldEdge = Edges[RandomIndex];
 
-		// Toggle between edge types
-		Edges[RandomIndex].Type = (Edges[RandomIndex].Type == EEvoEdgeType::HorizontalFirst)
+		// Toggle between edge types, unless the toggled edge already exists
+		FEvoEdge NewEdge = OldEdge;
+		NewEdge.Type = (OldEdge.Type == EEvoEdgeType::HorizontalFirst)
 			? EEvoEdgeType::VerticalFirst
 			: EEvoEdgeType::HorizontalFirst;
+		if (EdgeKeys.Contains(MakeEdgeKey(NewEdge)))
+		{
+			return;
+		}
+		SetEdge(RandomIndex, NewEdge);
+
+		if (OutLog)
+		{
+			LogEdgeChange(*OutLog, EEvoGraphChangeType::SetEdge, RandomIndex, OldEdge, NewEdge);
+		}
+	}
+
+	// Repeats a logged change on the state it was recorded on
+	void ApplyChange(const FEvoGraphChange& Change)
+	{
+		EnsureIndex();
+		switch (Change.Type)
+		{
+		case EEvoGraphChangeType::AddNode:
+		{
+			bool bNewSlot = false;
+			InsertNode(Change.Node, bNewSlot);
+			check(Nodes.Last().Id == Change.Node.Id);
+			break;
+		}
+		case EEvoGraphChangeType::RemoveNode:
+			RemoveNodeAt(Change.Index);
+			break;
+		case EEvoGraphChangeType::MoveNode:
+			SetNodeLocation(Change.Index, Change.NewLocation);
+			break;
+		case EEvoGraphChangeType::AddEdge:
+			InsertEdge(Change.NewEdge);
+			break;
+		case EEvoGraphChangeType::RemoveEdge:
+			RemoveEdgeAt(Change.Index);
+			break;
+		case EEvoGraphChangeType::SetEdge:
+			SetEdge(Change.Index, Change.NewEdge);
+			break;
+		}
+	}
+
+	// Undoes a logged change on the state right after it
+	void RevertChange(const FEvoGraphChange& Change)
+	{
+		EnsureIndex();
+		switch (Change.Type)
+		{
+		case EEvoGraphChangeType::AddNode:
+			UninsertNode(Change.bNewNodeSlot);
+			break;
+		case EEvoGraphChangeType::RemoveNode:
+			RestoreNodeAt(Change.Index, Change.Node);
+			break;
+		case EEvoGraphChangeType::MoveNode:
+			SetNodeLocation(Change.Index, Change.OldLocation);
+			break;
+		case EEvoGraphChangeType::AddEdge:
+			check(Change.Index == Edges.Num() - 1);
+			RemoveEdgeAt(Change.Index);
+			break;
+		case EEvoGraphChangeType::RemoveEdge:
+			RestoreEdgeAt(Change.Index, Change.NewEdge);
+			break;
+		case EEvoGraphChangeType::SetEdge:
+			SetEdge(Change.Index, Change.OldEdge);
+			break;
+		}
+	}
+
+private:
+	// Primitive edits that keep the index in sync. The Restore and Uninsert ones are the exact inverses used by RevertChange.
+
+	void SetCellOccupied(FIntPoint Cell, bool bOccupied)
+	{
+		const int32 CellIndex = Cell.Y * GridSize.X + Cell.X;
+		const uint64 Bit = 1ull << (CellIndex & 63);
+		if (bOccupied)
+		{
+			NodeOccupancy[CellIndex >> 6] |= Bit;
+		}
+		else
+		{
+			NodeOccupancy[CellIndex >> 6] &= ~Bit;
+		}
+	}
+
+	// Appends the node with a reused or new id, returns its index
+	int32 InsertNode(const FEvoNode& Node, bool& bOutNewSlot)
+	{
+		bOutNewSlot = FreeNodeIds.Num() == 0;
+		const int32 Id = bOutNewSlot ? NodeSlots.AddDefaulted() : FreeNodeIds.Pop(EAllowShrinking::No);
+		const int32 NodeIndex = Nodes.Add(Node);
+		Nodes[NodeIndex].Id = Id;
+		NodeSlots[Id].NodeIndex = NodeIndex;
+		SetCellOccupied(Node.Location, true);
+		return NodeIndex;
+	}
+
+	void UninsertNode(bool bNewSlot)
+	{
+		const FEvoNode& Node = Nodes.Last();
+		SetCellOccupied(Node.Location, false);
+		NodeSlots[Node.Id].NodeIndex = INDEX_NONE;
+		if (bNewSlot)
+		{
+			NodeSlots.Pop(EAllowShrinking::No);
+		}
+		else
+		{
+			FreeNodeIds.Add(Node.Id);
+		}
+		Nodes.Pop(EAllowShrinking::No);
+	}
+
+	// The node must not have edges left
+	void RemoveNodeAt(int32 NodeIndex)
+	{
+		const FEvoNode& Node = Nodes[NodeIndex];
+		check(Node.EdgeIndices.Num() == 0);
+		SetCellOccupied(Node.Location, false);
+		FEvoNodeSlot& Slot = NodeSlots[Node.Id];
+		Slot.NodeIndex = INDEX_NONE;
+		Slot.Generation++;
+		FreeNodeIds.Add(Node.Id);
+
+		Nodes.RemoveAtSwap(NodeIndex, 1, EAllowShrinking::No);
+		if (NodeIndex < Nodes.Num())
+		{
+			NodeSlots[Nodes[NodeIndex].Id].NodeIndex = NodeIndex;
+		}
+	}
+
+	void RestoreNodeAt(int32 NodeIndex, const FEvoNode& Node)
+	{
+		verify(FreeNodeIds.Pop(EAllowShrinking::No) == Node.Id);
+		if (NodeIndex < Nodes.Num())
+		{
+			// The node that was swapped into the gap goes back to the end
+			FEvoNode MovedNode = MoveTemp(Nodes[NodeIndex]);
+			NodeSlots[MovedNode.Id].NodeIndex = Nodes.Num();
+			Nodes.Add(MoveTemp(MovedNode));
+			Nodes[NodeIndex] = Node;
+		}
+		else
+		{
+			Nodes.Add(Node);
+		}
+		FEvoNodeSlot& Slot = NodeSlots[Node.Id];
+		Slot.NodeIndex = NodeIndex;
+		Slot.Generation--;
+		SetCellOccupied(Node.Location, true);
+	}
+
+	void SetNodeLocation(int32 NodeIndex, FIntPoint Location)
+	{
+		SetCellOccupied(Nodes[NodeIndex].Location, false);
+		Nodes[NodeIndex].Location = Location;
+		SetCellOccupied(Location, true);
+	}
+
+	int32 InsertEdge(const FEvoEdge& Edge)
+	{
+		const int32 EdgeIndex = Edges.Add(Edge);
+		EdgeKeys.Add(MakeEdgeKey(Edge));
+		GetNodeById(Edge.StartNodeId).EdgeIndices.Add(EdgeIndex);
+		GetNodeById(Edge.EndNodeId).EdgeIndices.Add(EdgeIndex);
+		return EdgeIndex;
+	}
+
+	// Points the adjacency entries of the edge at From to To
+	void RenumberEdge(int32 From, int32 To)
+	{
+		const FEvoEdge& Edge = Edges[From];
+		for (const int32 NodeId : { Edge.StartNodeId, Edge.EndNodeId })
+		{
+			TArray<int32, TInlineAllocator<4>>& EdgeIndices = GetNodeById(NodeId).EdgeIndices;
+			EdgeIndices[EdgeIndices.Find(From)] = To;
+		}
+	}
+
+	void RemoveEdgeAt(int32 EdgeIndex)
+	{
+		const FEvoEdge& Edge = Edges[EdgeIndex];
+		EdgeKeys.Remove(MakeEdgeKey(Edge));
+		GetNodeById(Edge.StartNodeId).EdgeIndices.RemoveSingleSwap(EdgeIndex, EAllowShrinking::No);
+		GetNodeById(Edge.EndNodeId).EdgeIndices.RemoveSingleSwap(EdgeIndex, EAllowShrinking::No);
+
+		const int32 LastIndex = Edges.Num() - 1;
+		if (EdgeIndex != LastIndex)
+		{
+			RenumberEdge(LastIndex, EdgeIndex);
+		}
+		Edges.RemoveAtSwap(EdgeIndex, 1, EAllowShrinking::No);
+	}
+
+	void RestoreEdgeAt(int32 EdgeIndex, const FEvoEdge& Edge)
+	{
+		if (EdgeIndex < Edges.Num())
+		{
+			// The edge that was swapped into the gap goes back to the end
+			const FEvoEdge MovedEdge = Edges[EdgeIndex];
+			RenumberEdge(EdgeIndex, Edges.Num());
+			Edges.Add(MovedEdge);
+			Edges[EdgeIndex] = Edge;
+		}
+		else
+		{
+			Edges.Add(Edge);
+		}
+		EdgeKeys.Add(MakeEdgeKey(Edge));
+		GetNodeById(Edge.StartNodeId).EdgeIndices.Add(EdgeIndex);
+		GetNodeById(Edge.EndNodeId).EdgeIndices.Add(EdgeIndex);
+	}
+
+	// Endpoints stay the same, only the type changes
+	void SetEdge(int32 EdgeIndex, const FEvoEdge& Edge)
+	{
+		EdgeKeys.Remove(MakeEdgeKey(Edges[EdgeIndex]));
+		EdgeKeys.Add(MakeEdgeKey(Edge));
+		Edges[EdgeIndex] = Edge;
+	}
+
+	// Node delta and a delta for every incident edge, at the node's current location
+	void AddMoveDeltas(FEvoMutationLog& Log, const FEvoNode& Node, bool bAdd) const
+	{
+		if (Node.AdditonalTags.Num() > 0)
+		{
+			Log.RasterDeltas.Add(FEvoRasterDelta::ForNode(Node, bAdd));
+		}
+		for (const int32 EdgeIndex : Node.EdgeIndices)
+		{
+			Log.RasterDeltas.Add(MakeEdgeDelta(Edges[EdgeIndex], bAdd));
+		}
+	}
+
+	// Logs an edge edit and its raster deltas, AddEdge and RemoveEdge only use NewEdge
+	void LogEdgeChange(FEvoMutationLog& Log, EEvoGraphChangeType Type, int32 Index, const FEvoEdge& OldEdge, const FEvoEdge& NewEdge) const
+	{
+		FEvoGraphChange& Change = Log.GraphChanges.AddDefaulted_GetRef();
+		Change.Type = Type;
+		Change.Index = Index;
+		Change.OldEdge = OldEdge;
+		Change.NewEdge = NewEdge;
+
+		if (Type != EEvoGraphChangeType::AddEdge)
+		{
+			Log.RasterDeltas.Add(MakeEdgeDelta(OldEdge, false));
+		}
+		if (Type != EEvoGraphChangeType::RemoveEdge)
+		{
+			Log.RasterDeltas.Add(MakeEdgeDelta(NewEdge, true));
+		}
 	}
 };
 
+inline void FEvoMutationLog::Undo(TArray<FEvoGraph>& Graphs) const
+{
+	for (int32 i = GraphChanges.Num() - 1; i >= 0; i--)
+	{
+		Graphs[GraphChanges[i].GraphIndex].RevertChange(GraphChanges[i]);
+	}
+}
+
+inline void FEvoMutationLog::Replay(TArray<FEvoGraph>& Graphs) const
+{
+	for (const FEvoGraphChange& Change : GraphChanges)
+	{
+		Graphs[Change.GraphIndex].ApplyChange(Change);
+	}
+}
+
 // =================================================== Grid Layer ===================================================
 
 
@@ -250,6 +1011,76 @@ public:
 
 	UPROPERTY()
 	TArray<EEvoTileTag> Tags;
+
+	SIZE_T GetAllocatedSize() const
+	{
+		return Tags.GetAllocatedSize();
+	}
+};
+
+// Tags of one FEvoGrid tile with the calls callers made on FEvoTile::Tags before the grid was packed into bit planes.
+// Reads and writes go straight to the planes without unpacking the tile. GridType is const FEvoGrid for GetTileConst, which has no writes.
+template<typename GridType>
+struct TEvoTileTags
+{
+	GridType& Grid;
+	int32 X;
+	int32 Y;
+
+	bool Contains(EEvoTileTag Tag) const
+	{
+		return Grid.HasTag(X, Y, Tag);
+	}
+
+	int32 Num() const
+	{
+		int32 Count = 0;
+		for (int32 TagIndex = 0; TagIndex < GridType::NumTileTags; ++TagIndex)
+		{
+			Count += Grid.HasTag(X, Y, static_cast<EEvoTileTag>(TagIndex)) ? 1 : 0;
+		}
+		return Count;
+	}
+
+	// A tile carries every tag at most once, so Add behaves like AddUnique
+	void Add(EEvoTileTag Tag) const
+	{
+		Grid.AddTileTag(X, Y, Tag);
+	}
+
+	void AddUnique(EEvoTileTag Tag) const
+	{
+		Grid.AddTileTag(X, Y, Tag);
+	}
+
+	void Remove(EEvoTileTag Tag) const
+	{
+		Grid.RemoveTileTag(X, Y, Tag);
+	}
+};
+
+// What FEvoGrid::GetTile and GetTileConst return in place of an FEvoTile reference, valid while the grid is not resized
+template<typename GridType>
+struct TEvoTileRef
+{
+	FIntPoint Location;
+	TEvoTileTags<GridType> Tags;
+
+	// Unpacked copy, allocates its tag array
+	FEvoTile ToTile() const
+	{
+		FEvoTile Tile;
+		Tile.Location = Location;
+		for (int32 TagIndex = 0; TagIndex < GridType::NumTileTags; ++TagIndex)
+		{
+			const EEvoTileTag Tag = static_cast<EEvoTileTag>(TagIndex);
+			if (Tags.Contains(Tag))
+			{
+				Tile.Tags.Add(Tag);
+			}
+		}
+		return Tile;
+	}
 };
 
 USTRUCT(BlueprintType)
@@ -258,41 +1089,176 @@ struct FEvoGrid
 	GENERATED_BODY()
 
 public:
+	static constexpr int32 NumTileTags = static_cast<int32>(EEvoTileTag::Destination) + 1;
+	static constexpr int32 BitsPerWord = 64;
+
+	// Summary blocks are one packed word wide and BlockRows rows high
+	static constexpr int32 BlockRows = 32;
+
 	UPROPERTY()
 	int32 Width = 64;
 	
 	UPROPERTY()
 	int32 Height = 64;
 
+	// Number of 64 bit words per packed row
+	UPROPERTY()
+	int32 WordsPerRow = 1;
+
+	// One packed bit row per tag and grid row, laid out as [Tag][Y][Word]. Bit X % 64 of word X / 64 is tile X.
+	// Bits past Width are always zero so row kernels can shift without masking.
+	UPROPERTY()
+	TArray<uint64> TagBits;
+
+	UPROPERTY()
+	int32 NumBlockRows = 2;
+
+	// Number of set tiles per tag and summary block, laid out as [Tag][Y / BlockRows][Word].
+	// Kept in sync by the tag setters, scans skip blocks whose count is zero.
 	UPROPERTY()
-	TArray<FEvoTile> Tiles;
+	TArray<uint16> BlockCounts;
+
+	SIZE_T GetAllocatedSize() const
+	{
+		return TagBits.GetAllocatedSize() + BlockCounts.GetAllocatedSize();
+	}
+
+	static FORCEINLINE int32 PopCount(uint64 Word)
+	{
+		return static_cast<int32>(FPlatformMath::CountBits(Word));
+	}
 
 	void Initialize(int32 NewWidth, int32 NewHeight)
 	{
 		Width = NewWidth;
 		Height = NewHeight;
+		WordsPerRow = FMath::Max(1, FMath::DivideAndRoundUp(Width, BitsPerWord));
+		NumBlockRows = FMath::DivideAndRoundUp(Height, BlockRows);
+
+		// Reset keeps the allocation so a reused grid does not hit the allocator again
+		TagBits.Reset();
+		TagBits.SetNumZeroed(NumTileTags * Height * WordsPerRow);
+		BlockCounts.Reset();
+		BlockCounts.SetNumZeroed(NumTileTags * NumBlockRows * WordsPerRow);
+	}
+
+	// Index into BlockCounts of the block holding word Word of row Y
+	FORCEINLINE int32 GetBlockIndex(EEvoTileTag Tag, int32 Word, int32 Y) const
+	{
+		return (static_cast<int32>(Tag) * NumBlockRows + Y / BlockRows) * WordsPerRow + Word;
+	}
+
+	FORCEINLINE int32 GetBlockCount(EEvoTileTag Tag, int32 Word, int32 Y) const
+	{
+		return BlockCounts[GetBlockIndex(Tag, Word, Y)];
+	}
+
+	// True if no tile of the block holding word Word of row Y carries any tag
+	bool IsBlockEmpty(int32 Word, int32 Y) const
+	{
+		for (int32 TagIndex = 0; TagIndex < NumTileTags; ++TagIndex)
+		{
+			if (GetBlockCount(static_cast<EEvoTileTag>(TagIndex), Word, Y) != 0)
+			{
+				return false;
+			}
+		}
+		return true;
+	}
 
-		Tiles.SetNum(Width * Height);    // Resizes the tile array
+	FORCEINLINE uint64* GetRow(EEvoTileTag Tag, int32 Y)
+	{
+		int32 Index = (static_cast<int32>(Tag) * Height + Y) * WordsPerRow;
+		check(TagBits.IsValidIndex(Index));
+		return TagBits.GetData() + Index;
 	}
 
-	FEvoTile& GetTile(int32 X, int32 Y)
+	FORCEINLINE const uint64* GetRow(EEvoTileTag Tag, int32 Y) const
 	{
-		int32 Index = Y * Width + X;
-		check(Tiles.IsValidIndex(Index));
-		return Tiles[Index];
+		int32 Index = (static_cast<int32>(Tag) * Height + Y) * WordsPerRow;
+		check(TagBits.IsValidIndex(Index));
+		return TagBits.GetData() + Index;
 	}
 
-	const FEvoTile& GetTileConst(int32 X, int32 Y) const
+	FORCEINLINE bool HasTag(int32 X, int32 Y, EEvoTileTag Tag) const
 	{
-		int32 Index = Y * Width + X;
-		check(Tiles.IsValidIndex(Index));
-		return Tiles[Index];
+		check(X >= 0 && X < Width);
+		return (GetRow(Tag, Y)[X / BitsPerWord] >> (X % BitsPerWord)) & 1;
 	}
 
 	// Adds a tile tag at a specific location
-	void AddTileTag(int32 X, int32 Y, EEvoTileTag Tag)
+	FORCEINLINE void AddTileTag(int32 X, int32 Y, EEvoTileTag Tag)
+	{
+		check(X >= 0 && X < Width);
+		uint64& Word = GetRow(Tag, Y)[X / BitsPerWord];
+		const uint64 Bit = uint64(1) << (X % BitsPerWord);
+		if ((Word & Bit) == 0)
+		{
+			Word |= Bit;
+			++BlockCounts[GetBlockIndex(Tag, X / BitsPerWord, Y)];
+		}
+	}
+
+	FORCEINLINE void RemoveTileTag(int32 X, int32 Y, EEvoTileTag Tag)
+	{
+		check(X >= 0 && X < Width);
+		uint64& Word = GetRow(Tag, Y)[X / BitsPerWord];
+		const uint64 Bit = uint64(1) << (X % BitsPerWord);
+		if ((Word & Bit) != 0)
+		{
+			Word &= ~Bit;
+			--BlockCounts[GetBlockIndex(Tag, X / BitsPerWord, Y)];
+		}
+	}
+
+	// Adds a tile tag to every tile in [MinX, MaxX] of row Y, one word at a time
+	void AddTileTagSpan(int32 MinX, int32 MaxX, int32 Y, EEvoTileTag Tag)
+	{
+		check(MinX >= 0 && MaxX < Width && MinX <= MaxX);
+		uint64* Row = GetRow(Tag, Y);
+		const int32 FirstWord = MinX / BitsPerWord;
+		const int32 LastWord = MaxX / BitsPerWord;
+		for (int32 Word = FirstWord; Word <= LastWord; ++Word)
+		{
+			const int32 Lo = (Word == FirstWord) ? MinX % BitsPerWord : 0;
+			const int32 Hi = (Word == LastWord) ? MaxX % BitsPerWord : BitsPerWord - 1;
+			const uint64 HighMask = (Hi == BitsPerWord - 1) ? ~uint64(0) : ((uint64(1) << (Hi + 1)) - 1);
+			const uint64 Added = HighMask & (~uint64(0) << Lo) & ~Row[Word];
+			Row[Word] |= Added;
+			BlockCounts[GetBlockIndex(Tag, Word, Y)] += static_cast<uint16>(PopCount(Added));
+		}
+	}
+
+	// Number of tiles carrying Tag, summed from the block counts
+	int32 CountTag(EEvoTileTag Tag) const
+	{
+		const int32 NumBlocks = NumBlockRows * WordsPerRow;
+		if (NumBlocks == 0 || BlockCounts.Num() == 0)
+		{
+			return 0;
+		}
+		const uint16* Counts = BlockCounts.GetData() + static_cast<int32>(Tag) * NumBlocks;
+		int32 Count = 0;
+		for (int32 i = 0; i < NumBlocks; ++i)
+		{
+			Count += Counts[i];
+		}
+		return Count;
+	}
+
+	// Compatibility accessors for the per-tile FEvoTile storage the grid had before its tags were packed. There is no FEvoTile to
+	// reference anymore, so both return a small view instead. Tile.Tags.Contains, Add, AddUnique and Remove keep working and cost
+	// one bit test or write, code that needs an actual FEvoTile calls ToTile, which allocates.
+	TEvoTileRef<FEvoGrid> GetTile(int32 X, int32 Y)
 	{
-		GetTile(X, Y).Tags.AddUnique(Tag);
+		check(X >= 0 && X < Width && Y >= 0 && Y < Height);
+		return { FIntPoint(X, Y), { *this, X, Y } };
+	}
+
+	TEvoTileRef<const FEvoGrid> GetTileConst(int32 X, int32 Y) const
+	{
+		check(X >= 0 && X < Width && Y >= 0 && Y < Height);
+		return { FIntPoint(X, Y), { *this, X, Y } };
 	}
 };
 
@@ -305,9 +1271,26 @@ struct FEvoTileInstruction
 	GENERATED_BODY()
 
 public:
+	// One bit per EEvoInstructionTag
 	UPROPERTY()
-	TArray<EEvoInstructionTag> Tags;
+	uint32 Tags = 0;
+
+	static constexpr uint32 TagBit(EEvoInstructionTag Tag)
+	{
+		return 1u << static_cast<uint32>(Tag);
+	}
+
+	FORCEINLINE bool HasTag(EEvoInstructionTag Tag) const
+	{
+		return (Tags & TagBit(Tag)) != 0;
+	}
+
+	FORCEINLINE void AddTag(EEvoInstructionTag Tag)
+	{
+		Tags |= TagBit(Tag);
+	}
 };
+static_assert(static_cast<int32>(EEvoInstructionTag::BridgeEastWest) < 32, "FEvoTileInstruction::Tags holds one bit per instruction tag");
 
 USTRUCT(BlueprintType)
 struct FEvoAssetMap
@@ -331,8 +1314,103 @@ public:
 		Height = NewHeight;
 		TileInstructions.SetNum(Width * Height);
 	}
+
+	SIZE_T GetAllocatedSize() const
+	{
+		return TileInstructions.GetAllocatedSize();
+	}
+};
+
+
+// =================================================== Evaluation Layer ===================================================
+
+USTRUCT(BlueprintType)
+struct FEvoEvaluationParams
+{
+	GENERATED_BODY()
+
+public:
+	UPROPERTY(EditAnywhere, BlueprintReadWrite)
+	int32 TargetStreetTiles = 800;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite)
+	int32 TargetCanalTiles = 400;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite)
+	int32 TargetStartStartDistance = 40;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite)
+	int32 TargetStartDestinationDistance = 60;
+};
+
+// Locations of the PlayerStart and Destination nodes, the input of the distance terms.
+// Starts are ordered by graph, then by node id, so removals that swap nodes around do not reorder them.
+struct FEvoKeyPoints
+{
+	TArray<FIntPoint> StartPositions;
+
+	// (-1, -1) if no node carries the Destination tag
+	FIntPoint Destination = FIntPoint(-1, -1);
+
+	SIZE_T GetAllocatedSize() const
+	{
+		return StartPositions.GetAllocatedSize();
+	}
 };
 
+// Every fitness term of one map, produced by UEvaluationFunctionLibrary::EvaluateMap in a single grid pass
+USTRUCT(BlueprintType)
+struct FEvoFitness
+{
+	GENERATED_BODY()
+
+public:
+	UPROPERTY(BlueprintReadOnly)
+	int32 StreetCount = 0;
+
+	UPROPERTY(BlueprintReadOnly)
+	int32 CanalCount = 0;
+
+	// Street+Canal tiles with at least one Street+Canal neighbor
+	UPROPERTY(BlueprintReadOnly)
+	int32 OverlapTiles = 0;
+
+	// Street+Canal neighbor pairs, each pair counted from both sides
+	UPROPERTY(BlueprintReadOnly)
+	int32 AdjacentOverlapPairs = 0;
+
+	// Per PlayerStart in FEvoKeyPoints order, -1 if the Destination is unreachable. Empty when there is no Destination.
+	UPROPERTY(BlueprintReadOnly)
+	TArray<int32> StartToDestinationDistances;
+
+	// Per PlayerStart pair (i, j) with i < j in the order (0,1), (0,2), ..., (1,2), ..., -1 if unreachable
+	UPROPERTY(BlueprintReadOnly)
+	TArray<int32> StartToStartDistances;
+
+	UPROPERTY(BlueprintReadOnly)
+	float StreetCountPenalty = 0.0f;
+
+	UPROPERTY(BlueprintReadOnly)
+	float CanalCountPenalty = 0.0f;
+
+	UPROPERTY(BlueprintReadOnly)
+	float OverlapPenalty = 0.0f;
+
+	UPROPERTY(BlueprintReadOnly)
+	float StartDestinationPenalty = 0.0f;
+
+	UPROPERTY(BlueprintReadOnly)
+	float StartStartPenalty = 0.0f;
+
+	// Sum of all penalties, the value the evolution maximizes
+	UPROPERTY(BlueprintReadOnly)
+	float Score = 0.0f;
+
+	SIZE_T GetAllocatedSize() const
+	{
+		return StartToDestinationDistances.GetAllocatedSize() + StartToStartDistances.GetAllocatedSize();
+	}
+};
 
 
 
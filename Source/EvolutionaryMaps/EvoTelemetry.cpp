@@ -0,0 +1,153 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "EvoTelemetry.h"
+#include "HAL/Event.h"
+#include "HAL/FileManager.h"
+#include "HAL/RunnableThread.h"
+
+FEvoTelemetry::~FEvoTelemetry()
+{
+	Close();
+}
+
+bool FEvoTelemetry::Open(const FString& BasePath, EEvoTelemetryFormat InFormat, int32 InSampleInterval)
+{
+	Close();
+
+	Format = InFormat;
+	SampleInterval = FMath::Max(1, InSampleInterval);
+
+	const FString FilePath = BasePath + ((Format == EEvoTelemetryFormat::Csv) ? TEXT(".csv") : TEXT(".jsonl"));
+	FileWriter = IFileManager::Get().CreateFileWriter(*FilePath);
+	if (!FileWriter)
+	{
+		UE_LOG(LogTemp, Warning, TEXT("Telemetry: could not open %s"), *FilePath);
+		return false;
+	}
+
+	if (Format == EEvoTelemetryFormat::Csv)
+	{
+		WriteLine(TEXT("Iteration,Accepted,IterationsSinceLastIncrease,Score,OffspringScore,StreetCount,CanalCount,OverlapTiles,")
+			TEXT("StreetCountPenalty,CanalCountPenalty,OverlapPenalty,StartDestinationPenalty,StartStartPenalty,")
+			TEXT("MutateMs,RasterizeMs,EvaluateMs,SelectMs,TotalMs"));
+	}
+
+	bStopRequested = false;
+	WakeEvent = FPlatformProcess::GetSynchEventFromPool(false);
+	Thread = FRunnableThread::Create(this, TEXT("EvoTelemetryWriter"), 0, TPri_BelowNormal);
+	return Thread != nullptr;
+}
+
+void FEvoTelemetry::Close()
+{
+	if (Thread)
+	{
+		Stop();
+		Thread->WaitForCompletion();
+		delete Thread;
+		Thread = nullptr;
+	}
+	if (WakeEvent)
+	{
+		FPlatformProcess::ReturnSynchEventToPool(WakeEvent);
+		WakeEvent = nullptr;
+	}
+	if (FileWriter)
+	{
+		// The writer thread is gone, anything it did not get to is written here
+		DrainQueue();
+		FileWriter->Close();
+		delete FileWriter;
+		FileWriter = nullptr;
+	}
+}
+
+void FEvoTelemetry::RecordIteration(const FEvoEvolution& Evolution, bool bAccepted)
+{
+	if (!IsOpen() || Evolution.IterationCounter % SampleInterval != 0)
+	{
+		return;
+	}
+
+	const FEvoFitness& Fitness = Evolution.IncumbentFitness;
+
+	FEvoIterationRecord Record;
+	Record.Iteration = Evolution.IterationCounter;
+	Record.bAccepted = bAccepted;
+	Record.IterationsSinceLastIncrease = Evolution.IterationsSinceLastIncrease;
+	Record.Score = Fitness.Score;
+	Record.OffspringScore = Evolution.LastOffspringScore;
+	Record.StreetCount = Fitness.StreetCount;
+	Record.CanalCount = Fitness.CanalCount;
+	Record.OverlapTiles = Fitness.OverlapTiles;
+	Record.StreetCountPenalty = Fitness.StreetCountPenalty;
+	Record.CanalCountPenalty = Fitness.CanalCountPenalty;
+	Record.OverlapPenalty = Fitness.OverlapPenalty;
+	Record.StartDestinationPenalty = Fitness.StartDestinationPenalty;
+	Record.StartStartPenalty = Fitness.StartStartPenalty;
+	Record.Timings = Evolution.LastTimings;
+
+	// The writer wakes up on its own timeout, no need to signal it per record
+	PendingRecords.Enqueue(Record);
+}
+
+uint32 FEvoTelemetry::Run()
+{
+	LLM_SCOPE_BYTAG(EvoMaps);
+	while (!bStopRequested)
+	{
+		WakeEvent->Wait(100);
+		DrainQueue();
+	}
+	DrainQueue();
+	return 0;
+}
+
+void FEvoTelemetry::Stop()
+{
+	bStopRequested = true;
+	if (WakeEvent)
+	{
+		WakeEvent->Trigger();
+	}
+}
+
+void FEvoTelemetry::DrainQueue()
+{
+	FEvoIterationRecord Record;
+	while (PendingRecords.Dequeue(Record))
+	{
+		WriteLine(FormatRecord(Record));
+	}
+}
+
+void FEvoTelemetry::WriteLine(const FString& Line)
+{
+	FTCHARToUTF8 Utf8(*Line);
+	FileWriter->Serialize(const_cast<ANSICHAR*>(Utf8.Get()), Utf8.Length());
+	FileWriter->Serialize(const_cast<ANSICHAR*>("\n"), 1);
+}
+
+FString FEvoTelemetry::FormatRecord(const FEvoIterationRecord& Record) const
+{
+	const FEvoStageTimings& Timings = Record.Timings;
+
+	if (Format == EEvoTelemetryFormat::Csv)
+	{
+		return FString::Printf(TEXT("%d,%d,%d,%f,%f,%d,%d,%d,%f,%f,%f,%f,%f,%.4f,%.4f,%.4f,%.4f,%.4f"),
+			Record.Iteration, Record.bAccepted ? 1 : 0, Record.IterationsSinceLastIncrease, Record.Score, Record.OffspringScore,
+			Record.StreetCount, Record.CanalCount, Record.OverlapTiles,
+			Record.StreetCountPenalty, Record.CanalCountPenalty, Record.OverlapPenalty, Record.StartDestinationPenalty, Record.StartStartPenalty,
+			Timings.MutateSeconds * 1000.0, Timings.RasterizeSeconds * 1000.0, Timings.EvaluateSeconds * 1000.0, Timings.SelectSeconds * 1000.0, Timings.TotalSeconds * 1000.0);
+	}
+
+	return FString::Printf(TEXT("{\"iteration\":%d,\"accepted\":%s,\"iterationsSinceLastIncrease\":%d,\"score\":%f,\"offspringScore\":%f,")
+		TEXT("\"streetCount\":%d,\"canalCount\":%d,\"overlapTiles\":%d,")
+		TEXT("\"streetCountPenalty\":%f,\"canalCountPenalty\":%f,\"overlapPenalty\":%f,\"startDestinationPenalty\":%f,\"startStartPenalty\":%f,")
+		TEXT("\"mutateMs\":%.4f,\"rasterizeMs\":%.4f,\"evaluateMs\":%.4f,\"selectMs\":%.4f,\"totalMs\":%.4f}"),
+		Record.Iteration, Record.bAccepted ? TEXT("true") : TEXT("false"), Record.IterationsSinceLastIncrease, Record.Score, Record.OffspringScore,
+		Record.StreetCount, Record.CanalCount, Record.OverlapTiles,
+		Record.StreetCountPenalty, Record.CanalCountPenalty, Record.OverlapPenalty, Record.StartDestinationPenalty, Record.StartStartPenalty,
+		Timings.MutateSeconds * 1000.0, Timings.RasterizeSeconds * 1000.0, Timings.EvaluateSeconds * 1000.0, Timings.SelectSeconds * 1000.0, Timings.TotalSeconds * 1000.0);
+}
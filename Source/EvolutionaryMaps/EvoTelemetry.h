@@ -0,0 +1,83 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "HAL/Runnable.h"
+#include "Containers/Queue.h"
+#include "EvoStructs.h"
+#include "EvoEvolution.h"
+#include <atomic>
+
+class FRunnableThread;
+class FEvent;
+
+// Scalars of one sampled iteration, small enough to copy into the writer queue
+struct FEvoIterationRecord
+{
+	int32 Iteration = 0;
+	bool bAccepted = false;
+	int32 IterationsSinceLastIncrease = 0;
+
+	// Incumbent after the iteration and best offspring of the iteration
+	float Score = 0.0f;
+	float OffspringScore = 0.0f;
+
+	int32 StreetCount = 0;
+	int32 CanalCount = 0;
+	int32 OverlapTiles = 0;
+	float StreetCountPenalty = 0.0f;
+	float CanalCountPenalty = 0.0f;
+	float OverlapPenalty = 0.0f;
+	float StartDestinationPenalty = 0.0f;
+	float StartStartPenalty = 0.0f;
+
+	FEvoStageTimings Timings;
+};
+
+/**
+ * Streams per-iteration records of an evolution run to disk as CSV or JSON Lines.
+ * RecordIteration only copies a few scalars into a queue, formatting and buffered file writes happen on a background thread.
+ */
+class EVOLUTIONARYMAPS_API FEvoTelemetry : public FRunnable
+{
+public:
+	FEvoTelemetry() = default;
+	FEvoTelemetry(const FEvoTelemetry&) = delete;
+	FEvoTelemetry& operator=(const FEvoTelemetry&) = delete;
+	virtual ~FEvoTelemetry();
+
+	// Opens BasePath plus .csv or .jsonl and starts the writer thread. Every SampleInterval-th iteration is recorded.
+	bool Open(const FString& BasePath, EEvoTelemetryFormat InFormat, int32 InSampleInterval);
+
+	// Writes everything still queued, then stops the thread and closes the file
+	void Close();
+
+	bool IsOpen() const
+	{
+		return Thread != nullptr;
+	}
+
+	// Call after every StepIteration, sampling is applied here
+	void RecordIteration(const FEvoEvolution& Evolution, bool bAccepted);
+
+	// FRunnable
+	virtual uint32 Run() override;
+	virtual void Stop() override;
+
+private:
+	void DrainQueue();
+	void WriteLine(const FString& Line);
+	FString FormatRecord(const FEvoIterationRecord& Record) const;
+
+	EEvoTelemetryFormat Format = EEvoTelemetryFormat::Csv;
+	int32 SampleInterval = 1;
+
+	// Produced on the evolution thread, consumed on the writer thread
+	TQueue<FEvoIterationRecord, EQueueMode::Spsc> PendingRecords;
+
+	FArchive* FileWriter = nullptr;
+	FRunnableThread* Thread = nullptr;
+	FEvent* WakeEvent = nullptr;
+	std::atomic<bool> bStopRequested { false };
+};
@@ -3,6 +3,7 @@
 
 #include "EvoVenice.h"
 #include "EvaluationFunctionLibrary.h"
+#include "EvoStats.h"
 
 // Sets default values
 AEvoVenice::AEvoVenice()
@@ -14,6 +15,7 @@ AEvoVenice::AEvoVenice()
 // Called when the game starts or when spawned
 void AEvoVenice::BeginPlay()
 {
+	LLM_SCOPE_BYTAG(EvoMaps);
 	Super::BeginPlay();
 	MapGen = Cast<UEvoMapGenerator>(NewObject<UObject>(this, MapGenClass));
 	AssetSpawner = Cast<AAssetSpawnerVenice>(GetWorld()->SpawnActor(AssetSpawnerClass));
@@ -22,10 +24,29 @@ void AEvoVenice::BeginPlay()
 }
 
 
+void AEvoVenice::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+	CancelAsyncRun();
+	if (Telemetry)
+	{
+		Telemetry->Close();
+	}
+	Super::EndPlay(EndPlayReason);
+}
+
 void AEvoVenice::Tick(float DeltaTime)
 {
+	LLM_SCOPE_BYTAG(EvoMaps);
 	Super::Tick(DeltaTime);
-	if (bTickMode && IterationCounter < MaximumIterations)
+	if (AsyncEvolution)
+	{
+		// Snapshots are published at most every RedrawIntervalSeconds, the whole grid is redrawn as several may have been skipped
+		if (const FEvoEvolutionSnapshot* Snapshot = AsyncEvolution->PollSnapshot())
+		{
+			MapGen->DrawGridToRenderTarget(this, Snapshot->Grid, RenderTargetAsset);
+		}
+	}
+	else if (bTickMode && Evolution.IterationCounter < MaximumIterations)
 	{
 		TickIteration();
 	}
@@ -33,29 +54,34 @@ void AEvoVenice::Tick(float DeltaTime)
 
 void AEvoVenice::InitializeMap()
 {
-	IterationCounter = 0;
+	TRACE_CPUPROFILER_EVENT_SCOPE(AEvoVenice::InitializeMap);
+	RunCounter++;
+	RunSeed = bRandomSeed ? FMath::Rand() : Seed + RunCounter - 1;
 
-	// Initialization
-	if (MapGen)
-	{
-		FEvoGraph StreetGraph;
-		StreetGraph = MapGen->InitGraph(Width, Height, EEvoTileTag::Street);
-		StreetGraph = MapGen->AddNodes(StreetGraph, 4, { EEvoTileTag::PlayerStart }, false, false);
-		StreetGraph = MapGen->AddNodes(StreetGraph, 1, { EEvoTileTag::Destination }, false, false);
-		StreetGraph = MapGen->AddNodes(StreetGraph, 10, {}, true, false);
-		StreetGraph = MapGen->AddEdges(StreetGraph, 10);
-		EvoGraphs.Add(StreetGraph);
+	Evolution.Initialize(MapGen, GetEvolutionSettings());
+	Evolution.ResetToVeniceStart();
+	RedrawGrid();
+	AverageIterationSeconds = 0.0;
 
-		FEvoGraph CanalGraph;
-		CanalGraph = MapGen->InitGraph(Width, Height, EEvoTileTag::Canal);
-		CanalGraph = MapGen->AddNodes(CanalGraph, 10, {}, true, false);
-		CanalGraph = MapGen->AddEdges(CanalGraph, 10);
-		EvoGraphs.Add(CanalGraph);
+	if (bWriteTelemetry)
+	{
+		if (!Telemetry)
+		{
+			Telemetry = MakeUnique<FEvoTelemetry>();
+		}
+		const FString BasePath = FPaths::ProjectSavedDir() / TEXT("Telemetry") / FString::Printf(TEXT("EvolutionData_%s_Run%d_Seed%d"), *FDateTime::Now().ToString(TEXT("%Y%m%d_%H%M%S")), RunCounter, RunSeed);
+		Telemetry->Open(BasePath, TelemetryFormat, TelemetrySampleInterval);
 	}
-	FEvoGrid Grid = MapGen->GenerateGridFromGraphs(EvoGraphs);
-	MapGen->DrawGridToRenderTarget(this, Grid, RenderTargetAsset);
 
-	if (!bTickMode)
+	if (bTickMode)
+	{
+		return;
+	}
+	if (bRunInBackground)
+	{
+		StartAsyncRun();
+	}
+	else
 	{
 		RunIterationsInstant();
 	}
@@ -63,105 +89,191 @@ void AEvoVenice::InitializeMap()
 
 void AEvoVenice::TickIteration()
 {
-	IterationCounter++;
+	TRACE_CPUPROFILER_EVENT_SCOPE(AEvoVenice::TickIteration);
+	const double SliceStartTime = FPlatformTime::Seconds();
+	const double BudgetSeconds = TickBudgetMilliseconds / 1000.0;
+	bool bAnyAccepted = false;
+	LastSliceIterations = 0;
 
-	TArray<FEvoGraph> MutatedGraphs = MapGen->MutateGraphArray(EvoGraphs, MutationsPerIteration);
-	FEvoGrid Grid = MapGen->GenerateGridFromGraphs(EvoGraphs);
-	FEvoGrid MutatedGrid = MapGen->GenerateGridFromGraphs(MutatedGraphs);
+	// At least one iteration per frame. Another one is only started if the average cost still fits, so the slice rarely overruns the budget.
+	while (Evolution.IterationCounter < MaximumIterations)
+	{
+		const double IterationStartTime = FPlatformTime::Seconds();
+		const bool bAccepted = Evolution.StepIteration();
+		ReportIteration(bAccepted);
+		bAnyAccepted |= bAccepted;
+		LastSliceIterations++;
 
-	float Value = ValueFunction(EvoGraphs, Grid);
-	float MutatedValue = ValueFunction(MutatedGraphs, MutatedGrid);
+		const double Now = FPlatformTime::Seconds();
+		const double IterationSeconds = Now - IterationStartTime;
+		AverageIterationSeconds = (AverageIterationSeconds > 0.0) ? FMath::Lerp(AverageIterationSeconds, IterationSeconds, 0.1) : IterationSeconds;
 
-	if (MutatedValue >= Value)
+		if (Now - SliceStartTime + AverageIterationSeconds > BudgetSeconds)
+		{
+			break;
+		}
+	}
+
+	if (bAnyAccepted)
 	{
-		EvoGraphs = MutatedGraphs;
-		MapGen->DrawGridToRenderTarget(this, MutatedGrid, RenderTargetAsset);
-		GEngine->AddOnScreenDebugMessage(-1, 5.f, FColor::Yellow, FString::Printf(TEXT("Value after %d Iterations: %f"), IterationCounter, MutatedValue));
+		RedrawGrid();
+		// One line keyed to this actor that is updated in place
+		GEngine->AddOnScreenDebugMessage(static_cast<uint64>(GetUniqueID()), 5.f, FColor::Yellow, FString::Printf(TEXT("Value after %d Iterations: %f (%d Iterations this frame)"), Evolution.IterationCounter, Evolution.IncumbentFitness.Score, LastSliceIterations));
 	}
-	else
+
+	if (Evolution.IterationCounter >= MaximumIterations)
 	{
-		MapGen->DrawGridToRenderTarget(this, Grid, RenderTargetAsset);
-		GEngine->AddOnScreenDebugMessage(-1, 5.f, FColor::Yellow, FString::Printf(TEXT("Value %d Iterations %f"), IterationCounter, Value));
+		FinishRun();
 	}
 }
 
 void AEvoVenice::RunIterationsInstant()
 {
-	//int RunID = 1;  
+	TRACE_CPUPROFILER_EVENT_SCOPE(AEvoVenice::RunIterationsInstant);
+	for (int i = 0; i < MaximumIterations; i++)
+	{
+		ReportIteration(Evolution.StepIteration());
+	}
 
-	//FString FilePath = FPaths::ProjectDir() + FString::Printf(TEXT("EvolutionData_Run%d.csv"), RunID);
-	//FString FileContent = "Iteration,Value\n"; // CSV Header
+	FinishRun();
+	SpawnIncumbentMap();
+}
 
-	int IterationsSinceLastIncrease = 0;
+void AEvoVenice::StartAsyncRun()
+{
+	FEvoAsyncEvolutionParams Params;
+	Params.Settings = Evolution.Settings;
+	Params.MaximumIterations = MaximumIterations;
+	Params.PublishIntervalSeconds = RedrawIntervalSeconds;
+	Params.Islands.NumIslands = NumIslands;
+	Params.Islands.MigrationInterval = MigrationInterval;
+	Params.Islands.StagnationLimit = IslandStagnationLimit;
+	Params.Telemetry = Telemetry && Telemetry->IsOpen() ? Telemetry.Get() : nullptr;
 
-	for (int i = 0; i < MaximumIterations; i++)
+	AsyncEvolution = FEvoAsyncEvolution::Launch(MapGen, Params,
+		FEvoAsyncEvolution::FOnProgress::CreateUObject(this, &AEvoVenice::HandleAsyncProgress),
+		FEvoAsyncEvolution::FOnCompleted::CreateUObject(this, &AEvoVenice::HandleAsyncCompleted));
+}
+
+void AEvoVenice::CancelAsyncRun()
+{
+	if (!AsyncEvolution)
 	{
-		IterationCounter++;
+		return;
+	}
+	AsyncEvolution->Cancel();
+	AsyncEvolution->Wait();
+	AsyncEvolution.Reset();
 
-		TArray<FEvoGraph> MutatedGraphs = MapGen->MutateGraphArray(EvoGraphs, MutationsPerIteration);
-		FEvoGrid Grid = MapGen->GenerateGridFromGraphs(EvoGraphs);
-		FEvoGrid MutatedGrid = MapGen->GenerateGridFromGraphs(MutatedGraphs);
+	if (Telemetry)
+	{
+		Telemetry->Close();
+	}
+}
 
-		float Value = ValueFunction(EvoGraphs, Grid);
-		float MutatedValue = ValueFunction(MutatedGraphs, MutatedGrid);
+void AEvoVenice::HandleAsyncProgress(int32 Iteration, const FEvoFitness& Fitness)
+{
+	GEngine->AddOnScreenDebugMessage(static_cast<uint64>(GetUniqueID()), 5.f, FColor::Yellow, FString::Printf(TEXT("Value after %d Iterations: %f"), Iteration, Fitness.Score));
+}
 
-		/*
-		if (Value <= -100000 && MutatedValue > -100000)
-		{
-			UE_LOG(LogTemp, Warning, TEXT("Iteration: %d Value: %f"), IterationCounter, MutatedValue);
-		}
-		if (Value > -10000)
-		{
-			FileContent += FString::Printf(TEXT("%d,%f\n"), IterationCounter, Value);
-		}
-		*/
-		if (MutatedValue >= Value)
-		{
-			IterationsSinceLastIncrease = 0;
-			EvoGraphs = MutatedGraphs;
-			MapGen->DrawGridToRenderTarget(this, MutatedGrid, RenderTargetAsset);
-			GEngine->AddOnScreenDebugMessage(-1, 5.f, FColor::Yellow, FString::Printf(TEXT("Value %d Iterations: %f"), IterationCounter, MutatedValue));
-		}
-		else
-		{
-			IterationsSinceLastIncrease += 1;
-			MapGen->DrawGridToRenderTarget(this, Grid, RenderTargetAsset);
-			GEngine->AddOnScreenDebugMessage(-1, 5.f, FColor::Yellow, FString::Printf(TEXT("Value %d Iterations %f"), IterationCounter, Value));
-		}
-		/*
-		if (IterationsSinceLastIncrease == 100)
-		{
-			UE_LOG(LogTemp, Warning, TEXT("Iteration: %d Value: %f"), IterationCounter, MutatedValue);
-		}
-		*/
+void AEvoVenice::HandleAsyncCompleted(const FEvoAsyncEvolution* Sender, const FEvoEvolutionSnapshot& Result, bool bCancelled)
+{
+	// A run replaced by CancelAsyncRun may have finished on its own and queued this before it was cancelled.
+	// The queued task keeps the sender alive, so its address cannot be reused by the current run.
+	if (Sender != AsyncEvolution.Get())
+	{
+		return;
+	}
+	AsyncEvolution.Reset();
+
+	Evolution.EvoGraphs = Result.Graphs;
+	Evolution.RebuildIncumbent();
+	Evolution.IterationCounter = Result.Iteration;
+
+	FinishRun();
+	SpawnIncumbentMap();
+}
+
+void AEvoVenice::SpawnIncumbentMap()
+{
+	TRACE_CPUPROFILER_EVENT_SCOPE(AEvoVenice::SpawnIncumbentMap);
+	FEvoAssetMap AssetMap = AssetSpawner->TranslateMap(Evolution.IncumbentGrid);
+	FRandomStream SpawnStream = Evolution.MakeSetupStream(FEvoEvolution::StreamAssetSpawn);
+	AssetSpawner->SpawnMap(AssetMap, SpawnStream);
+}
+
+void AEvoVenice::ReportIteration(bool bAccepted)
+{
+	if (Telemetry)
+	{
+		Telemetry->RecordIteration(Evolution, bAccepted);
+	}
+}
+
+void AEvoVenice::FinishRun()
+{
+	TRACE_CPUPROFILER_EVENT_SCOPE(AEvoVenice::FinishRun);
 
-		//FFileHelper::SaveStringToFile(FileContent, *FilePath);
+	// Instant and background runs leave their changes to the incumbent undrawn until here
+	RedrawGrid();
+
+	if (Telemetry)
+	{
+		Telemetry->Close();
 	}
 
-	FEvoGrid Grid = MapGen->GenerateGridFromGraphs(EvoGraphs);
-	UEvaluationFunctionLibrary::AnalyzeMap(EvoGraphs, Grid);
-	
-	FEvoAssetMap AssetMap = AssetSpawner->TranslateMap(Grid);
-	int a = 6;
-	AssetSpawner->SpawnMap(AssetMap);
+	GEngine->AddOnScreenDebugMessage(static_cast<uint64>(GetUniqueID()), 5.f, FColor::Yellow, FString::Printf(TEXT("Value after %d Iterations: %f (Seed %d)"), Evolution.IterationCounter, Evolution.IncumbentFitness.Score, RunSeed));
+	UEvaluationFunctionLibrary::AnalyzeMap(Evolution.EvoGraphs, Evolution.IncumbentGrid);
+}
+
+void AEvoVenice::RedrawGrid()
+{
+	if (Evolution.IncumbentDirtyRect.Area() <= 0)
+	{
+		return;
+	}
+
+	MapGen->DrawGridToRenderTarget(this, Evolution.IncumbentGrid, RenderTargetAsset, Evolution.IncumbentDirtyRect);
+	Evolution.IncumbentDirtyRect = FIntRect();
+}
 
+void AEvoVenice::GetMemoryFootprint(FEvoMemoryFootprint& Footprint) const
+{
+	Evolution.GetMemoryFootprint(Footprint);
+	if (AsyncEvolution)
+	{
+		Footprint += AsyncEvolution->GetMemoryFootprint();
+	}
 }
 
-float AEvoVenice::ValueFunction(TArray<FEvoGraph> Graphs, FEvoGrid Grid)
+FEvoEvolutionSettings AEvoVenice::GetEvolutionSettings() const
 {
-    float TotalValue = 0.0f;
+	FEvoEvolutionSettings Settings;
+	Settings.Width = Width;
+	Settings.Height = Height;
+	Settings.MutationsPerIteration = MutationsPerIteration;
+	Settings.OffspringPerIteration = OffspringPerIteration;
+	Settings.bValidateIncrementalRaster = bValidateIncrementalRaster;
+	Settings.Seed = RunSeed;
+	Settings.EvaluationParams = GetEvaluationParams();
+	return Settings;
+}
 
-	TotalValue += UEvaluationFunctionLibrary::TileCount(Grid, EEvoTileTag::Street, TargetStreetTiles);
-	TotalValue += UEvaluationFunctionLibrary::TileCount(Grid, EEvoTileTag::Canal, TargetCanalTiles);
-	TotalValue += UEvaluationFunctionLibrary::StreetCanalOverlap(Grid);
-	TotalValue += UEvaluationFunctionLibrary::PlayerStartDestinationDistance(Graphs, Grid,TargetStartDestinationDistance);
-	TotalValue += UEvaluationFunctionLibrary::StartToStartDistance(Graphs, Grid, TargetStartStartDistance);
-    return TotalValue;
+FEvoEvaluationParams AEvoVenice::GetEvaluationParams() const
+{
+	FEvoEvaluationParams Params;
+	Params.TargetStreetTiles = TargetStreetTiles;
+	Params.TargetCanalTiles = TargetCanalTiles;
+	Params.TargetStartStartDistance = TargetStartStartDistance;
+	Params.TargetStartDestinationDistance = TargetStartDestinationDistance;
+	return Params;
 }
 
 void AEvoVenice::RerunInstant()
 {
-	AssetSpawner->ClearMap();
+	LLM_SCOPE_BYTAG(EvoMaps);
+	// The spawned map stays until the new one is done, SpawnMap then only replaces the tiles that differ
+	CancelAsyncRun();
 	InitializeMap();
 }
 
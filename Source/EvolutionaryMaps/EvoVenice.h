@@ -10,6 +10,9 @@
 #include "Kismet/KismetRenderingLibrary.h"
 #include "AssetSpawnerVenice.h"
 #include "EvoMapGenerator.h"
+#include "EvoEvolution.h"
+#include "EvoTelemetry.h"
+#include "EvoAsyncEvolution.h"
 #include "EvoVenice.generated.h"
 
 UCLASS()
@@ -25,6 +28,8 @@ protected:
 	// Called when the game starts or when spawned
 	virtual void BeginPlay() override;
 
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
+
 
 public:
 
@@ -40,10 +45,48 @@ public:
 
 	UPROPERTY(EditAnywhere = "Algorithm Params")
 	bool bTickMode = false;
+	// Without tick mode, evolves on a background task instead of blocking the game thread. The render target follows the best map so far.
+	UPROPERTY(EditAnywhere = "Algorithm Params")
+	bool bRunInBackground = true;
 	UPROPERTY(EditAnywhere = "Algorithm Params")
 	int32 MaximumIterations = 1000;
 	UPROPERTY(EditAnywhere = "Algorithm Params")
 	int32 MutationsPerIteration = 20;
+	// Offspring per generation (lambda). They are rasterized and scored in parallel and the best one competes with the parent.
+	UPROPERTY(EditAnywhere = "Algorithm Params", meta = (ClampMin = "1"))
+	int32 OffspringPerIteration = 1;
+	// Independent populations evolved at once in the background, exchanging their best maps. 1 runs the plain (1+lambda) loop, tick mode always does.
+	UPROPERTY(EditAnywhere = "Algorithm Params", meta = (ClampMin = "1"))
+	int32 NumIslands = 1;
+	// Iterations of an island between sending its best map to the next island
+	UPROPERTY(EditAnywhere = "Algorithm Params", meta = (ClampMin = "0", EditCondition = "NumIslands > 1"))
+	int32 MigrationInterval = 50;
+	// Iterations without improvement after which an island adopts an incoming map even if it scores lower, 0 never
+	UPROPERTY(EditAnywhere = "Algorithm Params", meta = (ClampMin = "0", EditCondition = "NumIslands > 1"))
+	int32 IslandStagnationLimit = 200;
+	// Tick mode runs as many iterations per frame as fit in this budget, at least one. 0 runs exactly one per frame.
+	UPROPERTY(EditAnywhere = "Algorithm Params", meta = (ClampMin = "0", Units = "ms"))
+	float TickBudgetMilliseconds = 8.0f;
+	// Minimum wall-clock time between snapshots of a background run, each one redraws the whole grid. Tick mode ignores it and redraws once per frame with an acceptance.
+	UPROPERTY(EditAnywhere = "Algorithm Params", meta = (ClampMin = "0"))
+	float RedrawIntervalSeconds = 0.1f;
+	// Checks every incremental raster against a full GenerateGridFromGraphs rebuild, slow, for debugging only
+	UPROPERTY(EditAnywhere = "Algorithm Params")
+	bool bValidateIncrementalRaster = false;
+	// Picks a new seed for every run. Otherwise run N uses Seed + N - 1, so the same settings give the same maps.
+	UPROPERTY(EditAnywhere = "Algorithm Params")
+	bool bRandomSeed = true;
+	UPROPERTY(EditAnywhere = "Algorithm Params", meta = (EditCondition = "!bRandomSeed"))
+	int32 Seed = 0;
+
+	// Streams per-iteration fitness, acceptance and stage timings to Saved/Telemetry
+	UPROPERTY(EditAnywhere, Category = "Telemetry")
+	bool bWriteTelemetry = false;
+	UPROPERTY(EditAnywhere, Category = "Telemetry")
+	EEvoTelemetryFormat TelemetryFormat = EEvoTelemetryFormat::Csv;
+	// Record every Nth iteration
+	UPROPERTY(EditAnywhere, Category = "Telemetry", meta = (ClampMin = "1"))
+	int32 TelemetrySampleInterval = 1;
 
 	UPROPERTY(EditAnywhere, Category = "Evaluation Params")
 	int32 TargetStreetTiles = 800;
@@ -70,19 +113,56 @@ public:
 	UPROPERTY(EditAnywhere, BlueprintReadWrite, meta = (ExposeOnSpawn = "true"))
 	UTextureRenderTarget2D* RenderTargetAsset;
 
-	TArray<FEvoGraph> EvoGraphs;
+	FEvoEvolution Evolution;
+
+	TUniquePtr<FEvoTelemetry> Telemetry;
+
+	// Set while a background run is in flight
+	TSharedPtr<FEvoAsyncEvolution, ESPMode::ThreadSafe> AsyncEvolution;
+	int32 RunCounter = 0;
+
+	// Seed of the current run, shown with the final value so a good map can be reproduced
+	int32 RunSeed = 0;
 
 
 	void InitializeMap();
 
 
+	// Runs one frame's slice of iterations within TickBudgetMilliseconds and redraws once at the end
 	void TickIteration();
 	void RunIterationsInstant();
 
-	float ValueFunction(TArray<FEvoGraph> Graphs, FEvoGrid Grid);
+	void StartAsyncRun();
+
+	// Stops a background run and waits for its worker, its completion is ignored
+	void CancelAsyncRun();
 
-	int32 IterationCounter = 0;
+	void HandleAsyncProgress(int32 Iteration, const FEvoFitness& Fitness);
+	void HandleAsyncCompleted(const FEvoAsyncEvolution* Sender, const FEvoEvolutionSnapshot& Result, bool bCancelled);
 
+	void SpawnIncumbentMap();
+
+	// Records the last iteration to telemetry
+	void ReportIteration(bool bAccepted);
+
+	// Called once MaximumIterations is reached, in both modes
+	void FinishRun();
+
+	// Uploads the dirty part of the incumbent grid, unless nothing changed
+	void RedrawGrid();
+
+	// Moving average of the StepIteration cost in tick mode, used to stop a slice before it overruns the budget
+	double AverageIterationSeconds = 0.0;
+	int32 LastSliceIterations = 0;
+
+	FEvoEvaluationParams GetEvaluationParams() const;
+
+	FEvoEvolutionSettings GetEvolutionSettings() const;
+
+	// Starts a new run, in the background unless bTickMode is set or bRunInBackground is cleared
 	UFUNCTION(BlueprintCallable)
 	void RerunInstant();
+
+	// The tick mode evolution plus the last published state of a background run, see EvoMaps.DumpMemory
+	void GetMemoryFootprint(FEvoMemoryFootprint& Footprint) const;
 };